@@ -0,0 +1,318 @@
+/**
+ * Benchmarks the emulation core and prints the results as JSON.
+ *
+ * Micro benchmarks loop over copies of one opcode, macro benchmarks run
+ * the synthetic ROMs in roms.h. Every benchmark is run once per engine.
+ * Results whose steps ended early because the CPU was idle, such as the
+ * 0NNN and FX0A stalls, are marked idle_skipped and have no instruction
+ * count or MIPS.
+ *
+ * chip8_struct_bytes is sizeof(Chip8). It leaves out what an instance
+ * allocates once running, such as the JIT's block cache and code buffer
+ * and the block tables of a recompiled program.
+ */
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include "../include/Chip8.h"
+#include "../include/Opcodes.h"
+#include "roms.h"
+
+using namespace YACE;
+
+namespace
+{
+  const int COPIES = 64;                  // Copies of the opcode in a micro benchmark loop
+  const int MICRO_CYCLES = 20000;         // Cycles per step in micro benchmarks
+
+  enum LAYOUTS {REPEAT, JUMP_NEXT, CALL_RETURN, RESET_I};
+
+  struct Micro
+  {
+    const char* name;
+    unsigned short opcode;
+    LAYOUTS layout;
+    bool superchip;
+  };
+
+  // 00FD is left out since it resets the machine. FX55 and FX65 advance
+  // I, so every copy is preceded by an ANNN.
+  const Micro micros[] =
+  {
+    {"0NNN", 0x0000, REPEAT, false},
+    {"00CN", 0x00C1, REPEAT, true},
+    {"00E0", 0x00E0, REPEAT, false},
+    {"00FB", 0x00FB, REPEAT, true},
+    {"00FC", 0x00FC, REPEAT, true},
+    {"00FE", 0x00FE, REPEAT, false},
+    {"00FF", 0x00FF, REPEAT, false},
+    {"1NNN", 0x1000, JUMP_NEXT, false},
+    {"2NNN+00EE", 0x2000, CALL_RETURN, false},
+    {"3XNN", 0x3A01, REPEAT, false},
+    {"4XNN", 0x4A00, REPEAT, false},
+    {"5XY0", 0x5AB0, REPEAT, false},
+    {"6XNN", 0x6A55, REPEAT, false},
+    {"7XNN", 0x7A01, REPEAT, false},
+    {"8XY0", 0x8AB0, REPEAT, false},
+    {"8XY1", 0x8AB1, REPEAT, false},
+    {"8XY2", 0x8AB2, REPEAT, false},
+    {"8XY3", 0x8AB3, REPEAT, false},
+    {"8XY4", 0x8AB4, REPEAT, false},
+    {"8XY5", 0x8AB5, REPEAT, false},
+    {"8XY6", 0x8AB6, REPEAT, false},
+    {"8XY7", 0x8AB7, REPEAT, false},
+    {"8XYE", 0x8ABE, REPEAT, false},
+    {"9XY0", 0x9AB0, REPEAT, false},
+    {"ANNN", 0xA400, REPEAT, false},
+    {"BNNN", 0xB000, JUMP_NEXT, false},
+    {"CXNN", 0xCAFF, REPEAT, false},
+    {"DXYN_8x15", 0xD01F, REPEAT, false},
+    {"DXYN_16x16", 0xD010, REPEAT, true},
+    {"EX9E", 0xEA9E, REPEAT, false},
+    {"EXA1", 0xEAA1, REPEAT, false},
+    {"FX07", 0xFA07, REPEAT, false},
+    {"FX0A", 0xFA0A, REPEAT, false},
+    {"FX15", 0xFA15, REPEAT, false},
+    {"FX18", 0xFA18, REPEAT, false},
+    {"FX1E", 0xFA1E, REPEAT, false},
+    {"FX29", 0xFA29, REPEAT, false},
+    {"FX30", 0xFA30, REPEAT, false},
+    {"FX33", 0xFA33, REPEAT, false},
+    {"ANNN+FX55", 0xFF55, RESET_I, false},
+    {"ANNN+FX65", 0xFF65, RESET_I, false},
+    {"FX75", 0xF775, REPEAT, false},
+    {"FX85", 0xF785, REPEAT, false},
+    {"UNKNOWN", 0xF0FF, REPEAT, false}
+  };
+
+  struct Macro
+  {
+    const char* name;
+    const unsigned short* opcodes;
+    int count;
+  };
+
+  const Macro macros[] =
+  {
+    {"arithmetic", ROM_ARITHMETIC, sizeof(ROM_ARITHMETIC) / sizeof(ROM_ARITHMETIC[0])},
+    {"sprites", ROM_SPRITES, sizeof(ROM_SPRITES) / sizeof(ROM_SPRITES[0])},
+    {"recursion", ROM_RECURSION, sizeof(ROM_RECURSION) / sizeof(ROM_RECURSION[0])}
+  };
+
+  const char* const engine_names[] = {"interpreter", "threaded", "dynarec"};
+
+  const char* filter = 0;
+  bool first_result = true;
+
+  /**
+   *  Stores opcodes big endian at rom + 2 * index.
+   */
+  void put(unsigned char* rom, int index, unsigned short opcode)
+  {
+    rom[index * 2] = opcode >> 8;
+    rom[index * 2 + 1] = opcode & 0xFF;
+  }
+
+  /**
+   *  Builds the ROM of a micro benchmark and returns its length in bytes.
+   *  A prologue points I at free memory, then COPIES of the opcode loop
+   *  forever. DXYN gets a 16x16 sprite of alternating bits there, so
+   *  every draw flips pixels.
+   */
+  int build_micro(const Micro& micro, unsigned char* rom)
+  {
+    int length = 0;
+
+    if ((micro.opcode & 0xF000) == 0xD000)
+    {
+      for (int r = 0; r < 16; r++)
+        put(rom, length++, 0x6000 | (r << 8) | (r & 1 ? 0x55 : 0xAA));   // LD Vr, AA or 55
+
+      put(rom, length++, 0xA400);         // LD I, 400
+      put(rom, length++, 0xFF55);         // LD [I], V0..VF
+      put(rom, length++, 0xA410);         // LD I, 410
+      put(rom, length++, 0xFF55);         // LD [I], V0..VF
+      put(rom, length++, 0x6000);         // LD V0, 0
+      put(rom, length++, 0x6100);         // LD V1, 0
+    }
+
+    put(rom, length++, 0xA400);           // LD I, 400
+    if (micro.superchip)
+      put(rom, length++, 0x00FF);         // HIGH
+
+    int loop = length;
+
+    for (int i = 0; i < COPIES; i++)
+    {
+      unsigned int next = 0x200 + (length + 1) * 2;
+
+      switch (micro.layout)
+      {
+        case REPEAT:
+          put(rom, length++, micro.opcode);
+          break;
+        case JUMP_NEXT:
+          put(rom, length++, micro.opcode | next);
+          break;
+        case CALL_RETURN:
+          // Every call goes to the RET after the loop
+          put(rom, length++, micro.opcode | (0x200 + (loop + COPIES + 1) * 2));
+          break;
+        case RESET_I:
+          put(rom, length++, 0xA400);
+          put(rom, length++, micro.opcode);
+          break;
+      }
+    }
+
+    put(rom, length++, 0x1000 | (0x200 + loop * 2));    // JP loop
+    put(rom, length++, 0x00EE);                          // RET
+
+    return length * 2;
+  }
+
+  /**
+   *  Runs steps of a loaded instance once untimed and then timed, and
+   *  returns the timed seconds. idle is set if any timed step skipped
+   *  cycles because the CPU was idle.
+   */
+  double run(Chip8& chip8, int steps, bool& idle)
+  {
+    chip8.step();
+    idle = false;
+
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    for (int i = 0; i < steps; i++)
+    {
+      chip8.step();
+      idle |= chip8.is_idle();
+    }
+    std::chrono::steady_clock::time_point end = std::chrono::steady_clock::now();
+
+    return std::chrono::duration<double>(end - start).count();
+  }
+
+  void print_result(const char* kind, const char* name, int engine, int steps, int cycles, double seconds, bool idle)
+  {
+    unsigned long long instructions = (unsigned long long)steps * cycles;
+    char instructions_text[32] = "null";
+    char mips_text[32] = "null";
+
+    // Skipped cycles weren't executed, so there is no rate to report
+    if (!idle)
+    {
+      snprintf(instructions_text, sizeof(instructions_text), "%llu", instructions);
+      snprintf(mips_text, sizeof(mips_text), "%.3f", instructions / seconds / 1e6);
+    }
+
+    printf("%s\n    {\"kind\": \"%s\", \"name\": \"%s\", \"engine\": \"%s\", \"instructions\": %s, "
+           "\"frames\": %d, \"seconds\": %.6f, \"mips\": %s, \"fps\": %.1f, \"idle_skipped\": %s}",
+           first_result ? "" : ",", kind, name, engine_names[engine], instructions_text, steps, seconds,
+           mips_text, steps / seconds, idle ? "true" : "false");
+    fflush(stdout);
+    first_result = false;
+  }
+
+  bool selected(const char* name)
+  {
+    return !filter || std::strstr(name, filter);
+  }
+
+  void run_micros(int scale)
+  {
+    unsigned char rom[0x200];
+
+    for (unsigned int m = 0; m < sizeof(micros) / sizeof(micros[0]); m++)
+    {
+      if (!selected(micros[m].name))
+        continue;
+
+      int length = build_micro(micros[m], rom);
+
+      for (int engine = CPU::INTERPRETER; engine <= CPU::DYNAREC; engine++)
+      {
+        Chip8* chip8 = new Chip8();
+        chip8->set_cpu_engine(CPU::ENGINES(engine));
+        chip8->set_cpu_cycles(MICRO_CYCLES);
+        chip8->load_game(rom, length);
+
+        bool idle;
+        double seconds = run(*chip8, scale, idle);
+        print_result("micro", micros[m].name, engine, scale, MICRO_CYCLES, seconds, idle);
+        delete chip8;
+      }
+    }
+  }
+
+  void run_macros(int frames)
+  {
+    unsigned char rom[0x200];
+
+    for (unsigned int m = 0; m < sizeof(macros) / sizeof(macros[0]); m++)
+    {
+      if (!selected(macros[m].name))
+        continue;
+
+      for (int i = 0; i < macros[m].count; i++)
+        put(rom, i, macros[m].opcodes[i]);
+
+      for (int engine = CPU::INTERPRETER; engine <= CPU::DYNAREC; engine++)
+      {
+        Chip8* chip8 = new Chip8();
+        chip8->set_cpu_engine(CPU::ENGINES(engine));
+        chip8->load_game(rom, macros[m].count * 2);
+
+        bool idle;
+        double seconds = run(*chip8, frames, idle);
+        print_result("macro", macros[m].name, engine, frames, chip8->get_cpu_cycles(), seconds, idle);
+        delete chip8;
+      }
+    }
+  }
+}
+
+void show_help();
+
+int main(int argc, char **argv)
+{
+  int frames = 20000;
+  int scale = 100;
+
+  for (int i = 1; i < argc; i++)
+  {
+    if (!std::strcmp(argv[i], "-f") && i + 1 < argc)
+      frames = atoi(argv[++i]);
+    else if (!std::strcmp(argv[i], "-s") && i + 1 < argc)
+      scale = atoi(argv[++i]);
+    else if (argv[i][0] != '-' && !filter)
+      filter = argv[i];
+    else
+    {
+      show_help();
+      return 1;
+    }
+  }
+
+  if (frames <= 0 || scale <= 0)
+  {
+    show_help();
+    return 1;
+  }
+
+  printf("{\n  \"chip8_struct_bytes\": %u,\n  \"micro_cycles_per_step\": %d,\n  \"results\": [",
+         (unsigned int)sizeof(Chip8), MICRO_CYCLES);
+
+  run_micros(scale);
+  run_macros(frames);
+
+  printf("\n  ]\n}\n");
+  return 0;
+}
+
+void show_help()
+{
+  printf("Usage:\n");
+  printf("\tyace-bench [-f <macro frames>] [-s <micro steps>] [<name filter>]\n");
+}
@@ -0,0 +1,64 @@
+#ifndef YACE_BENCH_ROMS_H
+#define YACE_BENCH_ROMS_H
+
+/**
+ *  Synthetic ROMs run by the macro benchmarks, as opcodes loaded at 0x200.
+ */
+
+// Register arithmetic, shifts and skips in a tight loop
+const unsigned short ROM_ARITHMETIC[] =
+{
+  0x6000,   // 200: LD V0, 00
+  0x6100,   // 202: LD V1, 00
+  0x6201,   // 204: LD V2, 01
+  0x7001,   // 206: ADD V0, 01
+  0x8124,   // 208: ADD V1, V2
+  0x8306,   // 20A: SHR V3
+  0x8405,   // 20C: SUB V4, V0
+  0x8512,   // 20E: AND V5, V1
+  0x8633,   // 210: XOR V6, V3
+  0x870E,   // 212: SHL V7
+  0x3000,   // 214: SE V0, 00
+  0x1206,   // 216: JP 206
+  0x7201,   // 218: ADD V2, 01
+  0x1206    // 21A: JP 206
+};
+
+// Font digits drawn across the whole screen, erasing the previous pass
+const unsigned short ROM_SPRITES[] =
+{
+  0x00E0,   // 200: CLS
+  0x6000,   // 202: LD V0, 00
+  0x6100,   // 204: LD V1, 00
+  0x6200,   // 206: LD V2, 00
+  0x630F,   // 208: LD V3, 0F
+  0xF229,   // 20A: LD F, V2
+  0xD015,   // 20C: DRW V0, V1, 5
+  0x7005,   // 20E: ADD V0, 05
+  0x7201,   // 210: ADD V2, 01
+  0x8232,   // 212: AND V2, V3
+  0x403C,   // 214: SNE V0, 3C
+  0x121A,   // 216: JP 21A
+  0x120A,   // 218: JP 20A
+  0x6000,   // 21A: LD V0, 00
+  0x7106,   // 21C: ADD V1, 06
+  0x411E,   // 21E: SNE V1, 1E
+  0x6100,   // 220: LD V1, 00
+  0x120A    // 222: JP 20A
+};
+
+// Recursion 12 calls deep
+const unsigned short ROM_RECURSION[] =
+{
+  0x6000,   // 200: LD V0, 00
+  0x2206,   // 202: CALL 206
+  0x1202,   // 204: JP 202
+  0x7001,   // 206: ADD V0, 01
+  0x300C,   // 208: SE V0, 0C
+  0x2206,   // 20A: CALL 206
+  0x7101,   // 20C: ADD V1, 01
+  0x70FF,   // 20E: ADD V0, FF
+  0x00EE    // 210: RET
+};
+
+#endif
@@ -0,0 +1,54 @@
+#ifndef YACE_AUDIO_H
+#define YACE_AUDIO_H
+
+namespace YACE
+{
+  class Chip8;
+
+  /**
+   *  Generates the beep of a Chip8 as signed 16-bit mono PCM.
+   *
+   *  Samples are due up to the cycle the emulator has reached, at the
+   *  sample rate given. The tone starts and stops on the sample of the
+   *  cycle the sound timer was set or ran out, read from the sound events
+   *  of the Chip8, so it doesn't depend on how often samples are taken.
+   *  Samples are written in blocks straight to the caller's buffer.
+   *
+   *  Samples left waiting for more than Chip8::SOUND_EVENTS sound events
+   *  follow the sound timer as it is when they are generated.
+   */
+  class Audio
+  {
+    public:
+      Audio(Chip8& chip8, unsigned int sample_rate);
+
+      int generate(short* destination, int maximum);
+      int get_pending();
+      unsigned int get_sample_rate() const {return sample_rate;}
+      void set_tone(unsigned int frequency, short amplitude);
+      void sync();
+
+    private:
+      Chip8& chip8;
+      unsigned int sample_rate;
+
+      // Sample base_sample is due at cycle base_cycle, at cpu_frequency
+      unsigned long long base_cycle;
+      unsigned long long base_sample;
+      unsigned int cpu_frequency;
+
+      unsigned long long samples;       // Samples generated
+      unsigned long long events;        // Sound events read
+      bool on;
+
+      // Square wave, phase_step of 2^32 per period
+      unsigned int phase;
+      unsigned int phase_step;
+      short amplitude;
+
+      unsigned long long sample_at(unsigned long long cycle) const;
+      void rebase();
+  };
+}
+
+#endif
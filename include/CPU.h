@@ -3,7 +3,20 @@
 
 #include <cstdio>
 #include <cstdlib>
-#include <stack>
+
+#include "JIT.h"
+#include "Opcodes.h"
+#include "Profile.h"
+#include "Quirks.h"
+#include "Random.h"
+#include "Recompiled.h"
+#include "SaveState.h"
+#include "Trace.h"
+
+// Instructions are recorded one by one when tracing or profiling is built in
+#if defined(_TRACE_) || defined(_PROFILE_)
+#define YACE_INSTRUMENTED
+#endif
 
 namespace YACE
 {
@@ -13,15 +26,84 @@ namespace YACE
     public:
       CPU(Chip8& chip8);
 
+      enum ENGINES {INTERPRETER, THREADED, DYNAREC, RECOMPILED};
+
+      static const int MAX_IDLE_LOOP = 16;    // Opcodes in the longest idle loop detected
+      static const int MAX_FUSED = 3;         // Opcodes in the longest superinstruction
+
       void execute(int cycles);
+      ENGINES get_engine() {return engine;}
+      QUIRK_PROFILES get_quirks() {return quirks;}
+      bool is_idle() {return idle;}
+      void load_state(const SaveState& state);
+      void memory_written(unsigned int address, unsigned int length);
       void reset();
+      void save_state(SaveState& state) const;
+      void set_engine(ENGINES engine) {this->engine = engine;}
+      void set_quirks(QUIRK_PROFILES quirks);
+      void set_seed(unsigned long long seed) {random.seed(seed);}
+#ifdef _PROFILE_
+      void set_profile(Profile* profile) {this->profile = profile;}
+#endif
+#ifdef _TRACE_
+      void set_trace(Trace* trace) {this->trace = trace;}
+#endif
 
     private:
+      enum IDLE_LOOPS {IDLE_UNKNOWN, IDLE_CANDIDATE, IDLE_NEVER};
+
+      static const int IDLE_CHECK_INTERVAL = 64;  // Jumps back between idle loop checks
+      static const unsigned char UNDECODED = OPCODE_COUNT;  // Handler of an opcode not decoded yet
+
+      // Handlers of opcode sequences the threaded engine runs with one
+      // dispatch
+      enum SUPERINSTRUCTIONS {SUPER_ANNN_DXYN = UNDECODED + 1, SUPER_6XNN_6XNN, SUPER_7XNN_3XNN,
+                              SUPER_7XNN_4XNN, SUPER_7XNN_3XNN_1NNN, SUPER_7XNN_4XNN_1NNN,
+                              SUPER_FX07_3XNN, HANDLER_COUNT};
+
+      /**
+       *  An opcode decoded by the threaded engine the first time it ran at
+       *  an address. A superinstruction reads the opcodes after the first
+       *  from the following entries, whose fields are decoded with it.
+       */
+      struct DecodedOpcode
+      {
+        unsigned short opcode;
+        unsigned char handler;    // OPCODES or SUPERINSTRUCTIONS value, UNDECODED until it runs
+        unsigned char x : 4;
+        unsigned char y : 4;
+      };
+
+      /**
+       *  Engines instantiated for one quirk profile.
+       */
+      struct QuirkEngines
+      {
+        void (CPU::*interpret)(int cycles);
+        void (CPU::*execute_threaded)(int cycles);
+        void (CPU::*execute_dynarec)(int cycles);
+        void (CPU::*execute_recompiled)(int cycles);
+        bool shift_vy;                // Passed to the JIT
+      };
+
+      static const QuirkEngines QUIRK_ENGINES[QUIRK_PROFILE_COUNT];
+
       Chip8& chip8;
+      ENGINES engine;
+      QUIRK_PROFILES quirks;
+      const QuirkEngines* engines;    // Entry of QUIRK_ENGINES for quirks
+      JIT jit;
+      Recompiled recompiled;
+      Random random;
+#ifdef YACE_INSTRUMENTED
+      Trace* trace;
+      Profile* profile;
+#endif
       unsigned short opcode;
 
       // Stack
-      std::stack<unsigned int> stack;
+      unsigned int stack[16];
+      unsigned int stack_size;
 
       // Registers
       short I;
@@ -29,11 +111,56 @@ namespace YACE
       char RPL[8];
       unsigned int program_counter;
 
+      DecodedOpcode decoded[0x1000];  // Opcode starting at each address
+
+      /**
+       *  Everything an idle loop can read or write.
+       */
+      struct IdleState
+      {
+        char V[16];
+        short I;
+        unsigned int delay_timer;
+        unsigned int sound_timer;
+        bool key_is_pressed;
+        unsigned char last_key_pressed;
+      };
+
+      // Idle loop detection
+      bool idle;                  // The end of the last execute() was skipped
+      int cycles_left;            // Cycles left in interpret()
+      int interpret_end;          // Cycles from the start of execute() to the end of interpret()
+      bool probing;               // In loop_period()
+      int idle_countdown;         // Jumps back left until the next check
+      unsigned int idle_address;  // Jump back last taken in a candidate loop, 0 if none
+      IdleState idle_state;       // State when it was taken
+      unsigned char idle_loops[0x1000];  // IDLE_LOOPS of a jump back at each address
+
+      // Execution engines
+      void interpret(int cycles) {(this->*engines->interpret)(cycles);}
+      template <typename Quirks> void interpret(int cycles);
+      template <typename Quirks> void execute_threaded(int cycles);
+      template <typename Quirks> void execute_dynarec(int cycles);
+      template <typename Quirks> void execute_recompiled(int cycles);
+      template <typename Quirks, typename Code> void execute_blocks(Code& code, int cycles);
+      void decode(unsigned int address);
+      void forget_decoded(unsigned int address, unsigned int length);
+      int idle_cycles(unsigned int address, unsigned int target, int remaining);
+      bool is_idle_loop(unsigned int address, unsigned int target);
+      int loop_period(unsigned int address, unsigned int target);
+      void restore_idle_state(const IdleState& state);
+      void save_idle_state(IdleState& state);
+      const unsigned char* sprite_data(unsigned int address, int bytes, unsigned char* buffer) const;
+      void stall();
+#ifdef YACE_INSTRUMENTED
+      void execute_instrumented(int cycles);
+#endif
+
       // Opcode functions
       void handleOpcodes0x0000(unsigned short opcode);
-      void handleOpcodes0x8000(unsigned short opcode);
+      template <typename Quirks> void handleOpcodes0x8000(unsigned short opcode);
       void handleOpcodes0xE000(unsigned short opcode);
-      void handleOpcodes0xF000(unsigned short opcode);
+      template <typename Quirks> void handleOpcodes0xF000(unsigned short opcode);
       void opcode0x00E0(unsigned short opcode);
       void opcode0x00EE(unsigned short opcode);
       void opcode0x1NNN(unsigned short opcode);
@@ -49,25 +176,25 @@ namespace YACE
       void opcode0x8XY3(unsigned short opcode);
       void opcode0x8XY4(unsigned short opcode);
       void opcode0x8XY5(unsigned short opcode);
-      void opcode0x8XY6(unsigned short opcode);
+      template <typename Quirks> void opcode0x8XY6(unsigned short opcode);
       void opcode0x8XY7(unsigned short opcode);
-      void opcode0x8XYE(unsigned short opcode);
+      template <typename Quirks> void opcode0x8XYE(unsigned short opcode);
       void opcode0x9XY0(unsigned short opcode);
       void opcode0xANNN(unsigned short opcode);
-      void opcode0xBNNN(unsigned short opcode);
+      template <typename Quirks> void opcode0xBNNN(unsigned short opcode);
       void opcode0xCXNN(unsigned short opcode);
-      void opcode0xDXYN(unsigned short opcode);
+      template <typename Quirks> void opcode0xDXYN(unsigned short opcode);
       void opcode0xEX9E(unsigned short opcode);
       void opcode0xEXA1(unsigned short opcode);
       void opcode0xFX07(unsigned short opcode);
       void opcode0xFX0A(unsigned short opcode);
       void opcode0xFX15(unsigned short opcode);
       void opcode0xFX18(unsigned short opcode);
-      void opcode0xFX1E(unsigned short opcode);
+      template <typename Quirks> void opcode0xFX1E(unsigned short opcode);
       void opcode0xFX29(unsigned short opcode);
       void opcode0xFX33(unsigned short opcode);
-      void opcode0xFX55(unsigned short opcode);
-      void opcode0xFX65(unsigned short opcode);
+      template <typename Quirks> void opcode0xFX55(unsigned short opcode);
+      template <typename Quirks> void opcode0xFX65(unsigned short opcode);
 
       // Superchip opcodes
       void opcode0x00CN(unsigned short opcode);
@@ -80,6 +207,36 @@ namespace YACE
       void opcode0xFX75(unsigned short opcode);
       void opcode0xFX85(unsigned short opcode);
   };
+
+  /**
+   *  Must be called whenever emulated memory is written so translated
+   *  code stays in sync with self-modifying programs.
+   */
+  inline void CPU::memory_written(unsigned int address, unsigned int length)
+  {
+    if (jit.has_code())
+      jit.invalidate(address, length);
+    if (recompiled.is_resolved())
+      recompiled.invalidate(address, length);
+
+    // Opcodes overlapping the write, and superinstructions containing them
+    forget_decoded(address - (MAX_FUSED * 2 - 1), length + MAX_FUSED * 2 - 1);
+
+    // Loops ending up to MAX_IDLE_LOOP opcodes after the write
+    for (unsigned int i = address; i < address + length + MAX_IDLE_LOOP * 2; i++)
+      idle_loops[i & 0xFFF] = IDLE_UNKNOWN;
+  }
+
+  /**
+   *  Decodes opcodes from length addresses at address again when they next
+   *  run. Only the handler is reset, so the opcode running can still read
+   *  its fields after writing over itself.
+   */
+  inline void CPU::forget_decoded(unsigned int address, unsigned int length)
+  {
+    for (unsigned int i = 0; i < length && i < 0x1000; i++)
+      decoded[(address + i) & 0xFFF].handler = UNDECODED;
+  }
 }
 
 #endif
@@ -1,19 +1,18 @@
 #ifndef YACE_CHIP8_H
 #define YACE_CHIP8_H
 
-#ifdef _DEBUG_
-#define print_debug(args...) (printf(args))
-#else
-#define print_debug(args...) (void(0))
-#endif
-
 #include <cstdio>
 #include <cstring>
 
 #include "CPU.h"
+#include "Framebuffer.h"
+#include "RomCache.h"
+#include "SaveState.h"
 
 namespace YACE
 {
+  class Movie;
+
   class Chip8
   {
     public:
@@ -24,40 +23,111 @@ namespace YACE
 
       enum VIDEO_MODES {CHIP8, SUPERCHIP};
 
-      int get_cpu_cycles() {return cpu_cycles;}
+      /**
+       *  The sound timer becoming non-zero or reaching zero.
+       */
+      struct SoundEvent
+      {
+        unsigned long long cycle;   // get_cycles() when it happened
+        bool on;
+      };
+
+      static const int SOUND_EVENTS = 64;   // Newest events kept
+
+      unsigned long long frame_hash() {return video.get_hash();}
+      int get_cpu_cycles() {return cpu_frequency / timer_frequency;}
+      CPU::ENGINES get_cpu_engine() {return cpu.get_engine();}
+      unsigned int get_cpu_frequency() {return cpu_frequency;}
+      unsigned long long get_cycles() {return cycles;}
+      Framebuffer::DirtyRegion get_dirty_region() {return video.take_dirty_region();}
+      const Framebuffer& get_framebuffer() {return video;}
       bool get_key(EMU_KEYS key) {return keys[key];}
+      QUIRK_PROFILES get_quirks() {return cpu.get_quirks();}
+      unsigned long long get_rom_hash() {return rom_hash;}
+      unsigned long long get_seed() {return seed;}
+      const SoundEvent& get_sound_event(unsigned long long index) {return sound_events[index % SOUND_EVENTS];}
+      unsigned long long get_sound_event_count() {return sound_event_count;}
       unsigned int get_sound_timer() {return sound_timer;}
-      const char* get_video() {return (const char*)video;}
-      VIDEO_MODES get_video_mode() {return video_mode;}
+      unsigned int get_timer_frequency() {return timer_frequency;}
+      const char* get_video();
+      VIDEO_MODES get_video_mode() {return VIDEO_MODES(video.get_mode());}
+      bool is_frame_changed() {return video.is_dirty();}
+      bool is_idle() {return cpu.is_idle();}
       void load_game(const char* file);
+      void load_game(const unsigned char* game, int length);
+      void load_game(const Rom& rom);
+      void load_state(const SaveState& state);
+      void load_state(const char* file);
       void reset();
-      void set_cpu_cycles(int cycles) {cpu_cycles = cycles;}
+      void run_cycles(unsigned long long count) {run_until(cycles + count);}
+      void run_until(unsigned long long deadline);
+      void save_state(SaveState& state) const;
+      void save_state(const char* file) const;
+      void set_cpu_cycles(int cycles) {set_cpu_frequency(cycles * timer_frequency);}
+      void set_cpu_engine(CPU::ENGINES engine) {cpu.set_engine(engine);}
+      void set_cpu_frequency(unsigned int frequency);
       void set_key(EMU_KEYS key, bool pressed);
-      void step();
+#ifdef _PROFILE_
+      void set_profile(Profile* profile) {cpu.set_profile(profile);}
+#endif
+#ifdef _TRACE_
+      void set_trace(Trace* trace) {cpu.set_trace(trace);}
+#endif
+      void set_quirks(QUIRK_PROFILES quirks) {cpu.set_quirks(quirks);}
+      void set_seed(unsigned long long seed) {this->seed = seed; cpu.set_seed(seed);}
+      void set_timer_frequency(unsigned int frequency);
+      unsigned long long state_hash() const;
+      void step() {run_until(next_tick);}
 
       friend class CPU;
+      friend class Movie;
+      friend class Rewind;
 
     private:
       const int FONT_CHIP8;
       const int FONT_SUPERCHIP;
 
       CPU cpu;
-      int cpu_cycles;
       unsigned char memory[0x1000];
-      char video[0x2000];
-      VIDEO_MODES video_mode;
+      Framebuffer video;
+
+      // Byte per pixel copy of video, expanded on demand
+      char pixels[0x2000];
+      unsigned int pixels_revision;
 
       // Timers
       unsigned int delay_timer;
       unsigned int sound_timer;
 
+      // Ring of the newest sound events, sound_event_count written so far
+      SoundEvent sound_events[SOUND_EVENTS];
+      unsigned long long sound_event_count;
+
+      // Scheduler, timer tick k after timer_base is due at cycle
+      // timer_base + ceil(k * cpu_frequency / timer_frequency)
+      unsigned int cpu_frequency;
+      unsigned int timer_frequency;
+      unsigned long long cycles;        // Cycles run since construction
+      unsigned long long timer_base;
+      unsigned int timer_ticks;         // Ticks since timer_base
+      unsigned long long next_tick;     // Cycle the next tick is due
+
       bool keys[16];
       bool key_is_pressed;
       unsigned char last_key_pressed;
 
+      unsigned long long rom_hash;      // Of the last game loaded
+      unsigned long long seed;          // Last seed of the CXNN generator
+      Movie* movie;                     // Recording or playing back input, or 0
+
+      void press_key(EMU_KEYS key, bool pressed);
       void setup_fonts();
-      void read_font(const char* file, unsigned char* destination, int size); 
       void reset_video();
+      void restart_timer_period();
+      void restore_state(const SaveState& state);
+      void schedule_tick();
+      void set_sound_timer(unsigned int value, unsigned long long cycle);
+      void tick_timers();
   };
 }
 
@@ -0,0 +1,99 @@
+#ifndef YACE_CHIP8_BATCH_H
+#define YACE_CHIP8_BATCH_H
+
+#include "Chip8.h"
+
+namespace YACE
+{
+  /**
+   *  Runs many instances of the same game in lockstep.
+   *
+   *  All state is stored as structure-of-arrays with one lane per instance,
+   *  so instances executing the same opcode at the same address are stepped
+   *  together with vector operations, 32 lanes at a time with AVX2 when
+   *  the CPU supports it and 16 with SSE2 otherwise. Lanes that have
+   *  diverged are stepped one at a time.
+   */
+  class Chip8Batch
+  {
+    public:
+      Chip8Batch(int instances);
+      ~Chip8Batch();
+
+      unsigned long long frame_hash(int instance) {return video[instance].get_hash();}
+      int get_cpu_cycles() {return cpu_cycles;}
+      Framebuffer::DirtyRegion get_dirty_region(int instance) {return video[instance].take_dirty_region();}
+      const Framebuffer& get_framebuffer(int instance) {return video[instance];}
+      int get_instances() {return instances;}
+      unsigned int get_sound_timer(int instance) {return sound_timer[instance];}
+      const char* get_video(int instance);
+      Chip8::VIDEO_MODES get_video_mode(int instance) {return Chip8::VIDEO_MODES(video[instance].get_mode());}
+      bool is_frame_changed(int instance) {return video[instance].is_dirty();}
+      void load_game(const char* file);
+      void load_game(const unsigned char* game, int length);
+      void load_game(const Rom& rom) {load_game(rom.data, rom.length);}
+      void reset();
+      void set_cpu_cycles(int cycles) {cpu_cycles = cycles;}
+      void set_key(int instance, Chip8::EMU_KEYS key, bool pressed);
+      void set_seed(int instance, unsigned long long seed) {random[instance].seed(seed);}
+      void step();
+
+    private:
+      static const int FONT_CHIP8 = 0x109;
+      static const int FONT_SUPERCHIP = 0x159;
+
+      int instances;
+      int lanes;        // Instances rounded up to the widest vector
+      int cpu_cycles;
+
+      // Lane-interleaved state, indexed [element * lanes + lane]
+      unsigned char* memory;
+      char* V;
+      char* RPL;
+      unsigned int* stack;
+      bool* keys;
+
+      // Per-lane state
+      unsigned int* program_counter;
+      short* I;
+      unsigned char* stack_size;
+      unsigned int* delay_timer;
+      unsigned int* sound_timer;
+      bool* key_is_pressed;
+      unsigned char* last_key_pressed;
+      Random* random;
+      Framebuffer* video;
+
+      char pixels[0x2000];    // Expanded screen returned by get_video()
+
+      // Lane masks (0xFF or 0) used while grouping lanes
+      unsigned char* active;
+      unsigned char* pending;
+      unsigned char* group;
+      unsigned char* skip;
+
+      bool converged;         // All instances share common_program_counter
+      unsigned int common_program_counter;
+      bool memory_diverged;   // Instances may hold different opcodes at the same address
+#if defined(__x86_64__)
+      bool avx2;              // step() uses execute_avx2
+#endif
+
+      Chip8Batch(const Chip8Batch&);
+      Chip8Batch& operator=(const Chip8Batch&);
+
+      template <int Width> void execute(int cycles);
+#if defined(__x86_64__)
+      void execute_avx2(int cycles);
+#endif
+      void execute_lane(int lane);
+      template <int Width> bool execute_vector(unsigned short opcode);
+      template <int Width> bool find_skips(unsigned short opcode);
+      void reset_lane(int lane);
+      template <int Width> bool same_opcode(unsigned int address);
+      bool same_program_counter();
+      void spread_program_counter();
+  };
+}
+
+#endif
@@ -0,0 +1,111 @@
+#ifndef YACE_EMULATOR_POOL_H
+#define YACE_EMULATOR_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "Chip8.h"
+
+namespace YACE
+{
+  /**
+   *  Independent Chip8 instances run on a pool of worker threads.
+   *
+   *  Tasks submitted for an instance run one at a time in submission
+   *  order, tasks for different instances run in parallel. Every worker
+   *  is pinned to its own core where supported and keeps a queue of the
+   *  instances it runs, an instance goes back to the worker that last ran
+   *  it and idle workers steal instances from the others. Queues are only
+   *  locked between tasks, never while an instance runs.
+   */
+  class EmulatorPool
+  {
+    public:
+      /**
+       *  State of an instance after one frame of run_frames.
+       */
+      struct Frame
+      {
+        unsigned long long cycles;            // Chip8::get_cycles()
+        Framebuffer::DirtyRegion dirty;       // Pixels changed during the frame
+        unsigned int sound_timer;
+        bool idle;
+      };
+
+      EmulatorPool(int instances, int threads = 0);
+      ~EmulatorPool();
+
+      Chip8& get_instance(int id) {check_instance(id); return slots[id].chip8;}
+      int get_instances() {return instances;}
+      int get_threads() {return threads;}
+      std::future<std::vector<Frame> > run_frames(int id, int frames);
+      template <typename Task>
+      std::future<std::invoke_result_t<Task, Chip8&> > submit(int id, Task task);
+
+    private:
+      struct Slot
+      {
+        Chip8 chip8;
+        std::mutex mutex;
+        std::deque<std::function<void()> > tasks;
+        bool queued;                          // In a worker queue or running
+      };
+
+      struct alignas(64) Worker
+      {
+        std::mutex mutex;
+        std::deque<int> queue;                // Ids of instances with tasks
+        std::thread thread;
+      };
+
+      int instances;
+      int threads;
+      Slot* slots;
+      Worker* workers;
+
+      std::atomic<int> queued;                // Ids in all worker queues
+      std::atomic<int> sleeping;              // Workers waiting for work
+      std::mutex sleep_mutex;
+      std::condition_variable wake;
+      bool stopping;
+
+      void check_instance(int id) const;
+      void enqueue(int id, std::function<void()> task);
+      void push(int worker, int id);
+      void run(int worker);
+      bool take(int worker, int& id);
+
+      EmulatorPool(const EmulatorPool&);
+      EmulatorPool& operator=(const EmulatorPool&);
+  };
+
+  /**
+   *  Queues task(chip8) for an instance and returns its result. Exceptions
+   *  thrown by task are rethrown by the future.
+   */
+  template <typename Task>
+  std::future<std::invoke_result_t<Task, Chip8&> > EmulatorPool::submit(int id, Task task)
+  {
+    typedef std::invoke_result_t<Task, Chip8&> Result;
+
+    check_instance(id);
+
+    Chip8& chip8 = slots[id].chip8;
+    std::shared_ptr<std::packaged_task<Result()> > packaged =
+      std::make_shared<std::packaged_task<Result()> >([task, &chip8]() mutable {return task(chip8);});
+    std::future<Result> result = packaged->get_future();
+
+    enqueue(id, [packaged]() {(*packaged)();});
+    return result;
+  }
+}
+
+#endif
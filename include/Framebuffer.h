@@ -0,0 +1,156 @@
+#ifndef YACE_FRAMEBUFFER_H
+#define YACE_FRAMEBUFFER_H
+
+namespace YACE
+{
+  /**
+   *  1 bit per pixel framebuffer.
+   *
+   *  Every row is a 128-bit word with the leftmost pixel in the most
+   *  significant bit. In Chip-8 mode only the upper 64 bits of the first
+   *  32 rows are used. Sprites are drawn with one shift, AND and XOR per
+   *  row and scrolling shifts whole rows.
+   *
+   *  A hash of the visible screen is kept as the XOR of one hash per row.
+   *  Changed rows are only marked, get_hash() rehashes just those.
+   */
+  class Framebuffer
+  {
+    public:
+      typedef unsigned __int128 Row;
+
+      enum MODES {CHIP8, SUPERCHIP};
+
+      /**
+       *  Pixels changed since the region was last taken.
+       */
+      struct DirtyRegion
+      {
+        unsigned long long rows;    // Bit y is set if row y changed
+        int x, y, width, height;    // Bounding rectangle of the changed pixels
+        bool mode_changed;          // Resolution changed, the whole screen must be redrawn
+      };
+
+      Framebuffer();
+
+      void clear();
+      bool draw_sprite(int x, int y, const unsigned char* data, int lines, int width);
+      bool draw_wrapped_sprite(int x, int y, const unsigned char* data, int lines, int width);
+      void expand(char* destination) const;
+      unsigned long long get_dirty_rows() const {return dirty_rows;}
+      unsigned long long get_hash();
+      int get_height() const {return 32 << mode;}
+      MODES get_mode() const {return mode;}
+      unsigned int get_revision() const {return revision;}
+      const Row* get_rows() const {return rows;}
+      int get_width() const {return 64 << mode;}
+      bool is_dirty() const {return dirty_rows != 0 || mode_changed;}
+      void load(const Row* rows, MODES mode);
+      void scroll_down(int lines);
+      void scroll_left();
+      void scroll_right();
+      void set_mode(MODES mode);
+      DirtyRegion take_dirty_region();
+
+    private:
+      Row rows[64];
+      MODES mode;
+      unsigned int revision;  // Incremented on every change
+
+      // Changes since the last call to take_dirty_region()
+      unsigned long long dirty_rows;
+      Row dirty_columns;      // Union of all changed pixels
+      bool mode_changed;
+
+      unsigned long long row_hashes[64];  // Hash of each visible row, 0 for hidden rows
+      unsigned long long hash;            // XOR of row_hashes
+      unsigned long long stale_rows;      // Bit y is set if row_hashes[y] is out of date
+
+      void mark_dirty(int y, Row changed)
+      {
+        unsigned long long row = (unsigned long long)(changed != 0) << y;
+
+        dirty_rows |= row;
+        dirty_columns |= changed;
+        stale_rows |= row;
+      }
+      void mark_screen_dirty()
+      {
+        dirty_rows = mode == SUPERCHIP ? ~0ULL : 0xFFFFFFFFULL;
+        dirty_columns = screen_mask();
+        mode_changed = true;
+        stale_rows = ~0ULL;
+      }
+      Row screen_mask() const {return mode == SUPERCHIP ? ~Row(0) : ~Row(0) << 64;}
+  };
+
+  /**
+   *  Draws a sprite of the given number of lines, 8 or 16 pixels wide, and
+   *  returns true if any lit pixel was turned off. The sprite starts at
+   *  (x, y) wrapped to the screen and is clipped at the right and bottom
+   *  edges.
+   */
+  inline bool Framebuffer::draw_sprite(int x, int y, const unsigned char* data, int lines, int width)
+  {
+    Row mask = screen_mask();
+    Row collision = 0;
+
+    x &= get_width() - 1;
+    y &= get_height() - 1;
+
+    if (lines > get_height() - y)
+      lines = get_height() - y;
+
+    for (int line = 0; line < lines; line++)
+    {
+      unsigned int bits = data[0];
+      if (width == 16)
+        bits = (bits << 8) | data[1];
+      data += width / 8;
+
+      Row sprite = ((Row(bits) << (128 - width)) >> x) & mask;
+      collision |= rows[y + line] & sprite;
+      rows[y + line] ^= sprite;
+      mark_dirty(y + line, sprite);
+    }
+
+    revision++;
+    return collision != 0;
+  }
+
+  /**
+   *  Like draw_sprite, but pixels past the right and bottom edges wrap
+   *  around to the left and top.
+   */
+  inline bool Framebuffer::draw_wrapped_sprite(int x, int y, const unsigned char* data, int lines, int width)
+  {
+    Row mask = screen_mask();
+    Row collision = 0;
+
+    x &= get_width() - 1;
+    y &= get_height() - 1;
+
+    for (int line = 0; line < lines; line++)
+    {
+      unsigned int bits = data[0];
+      if (width == 16)
+        bits = (bits << 8) | data[1];
+      data += width / 8;
+
+      // Rotate within the screen width, left aligned in the row
+      Row sprite = Row(bits) << (128 - width);
+      Row wrapped = x ? sprite << (get_width() - x) : 0;
+      int row = (y + line) & (get_height() - 1);
+
+      sprite = ((sprite >> x) | wrapped) & mask;
+      collision |= rows[row] & sprite;
+      rows[row] ^= sprite;
+      mark_dirty(row, sprite);
+    }
+
+    revision++;
+    return collision != 0;
+  }
+}
+
+#endif
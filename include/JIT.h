@@ -0,0 +1,54 @@
+#ifndef YACE_JIT_H
+#define YACE_JIT_H
+
+namespace YACE
+{
+  /**
+   *  x86-64 basic block translator.
+   *
+   *  Translates straight-line runs of register opcodes starting at an
+   *  address into native code and caches them by address. Blocks end at a
+   *  jump, a skip or the first opcode the translator doesn't handle, which
+   *  is then left to the interpreter. On other hosts no blocks are built.
+   *
+   *  The cache is only allocated once the first block is requested. Its
+   *  code buffer is writable while blocks are translated and executable
+   *  while they run, never both at once.
+   */
+  class JIT
+  {
+    public:
+      typedef void (*Code)(char* V, short* I, unsigned int* program_counter);
+
+      struct Block
+      {
+        Code code;
+        unsigned int start;
+        unsigned int end;     // First address after the block
+        int length;           // Number of opcodes executed by the block
+      };
+
+      JIT();
+      JIT(const JIT& other);
+      ~JIT();
+
+      JIT& operator=(const JIT& other);
+
+      void flush();
+      const Block* get_block(const unsigned char* memory, unsigned int address);
+      bool has_code() const {return cache != 0;}
+      void invalidate(unsigned int address, unsigned int length);
+      void set_shift_vy(bool shift_vy);
+
+    private:
+      struct Cache;
+      Cache* cache;
+      bool shift_vy;          // 8XY6/8XYE shift VY into VX
+
+      bool compile(const unsigned char* memory, unsigned int address);
+      void drop(unsigned int address);
+      bool set_writable(bool writable);
+  };
+}
+
+#endif
@@ -0,0 +1,118 @@
+#ifndef YACE_MOVIE_H
+#define YACE_MOVIE_H
+
+#include <vector>
+
+#include "Chip8.h"
+#include "SaveState.h"
+
+namespace YACE
+{
+  /**
+   *  Header of a saved movie, followed by the SaveState it starts from
+   *  and input_size bytes of input.
+   *
+   *  The input is a list of entries, each the cycles since the previous
+   *  one (or the start) as a base 128 varint, then a byte holding the
+   *  key index in the low 4 bits, PRESSED and CHECKPOINT. A checkpoint is
+   *  followed by the 8 byte little-endian Chip8::state_hash at its cycle.
+   */
+  struct MovieHeader
+  {
+    static const unsigned int MAGIC = 0x564F4D59;    // "YMOV"
+    static const unsigned int VERSION = 1;
+
+    enum FLAGS {PRESSED = 0x10, CHECKPOINT = 0x20};
+
+    unsigned int magic;
+    unsigned int version;
+    unsigned int state_size;          // sizeof(SaveState)
+    unsigned int input_size;
+    unsigned long long rom_hash;      // Chip8::get_rom_hash() when recorded
+    unsigned long long seed;          // Chip8::get_seed() when recorded
+    unsigned long long length;        // Cycles recorded
+    unsigned int cpu_frequency;
+    unsigned int timer_frequency;
+    unsigned int quirks;
+    unsigned int reserved;            // Zero
+  };
+
+  /**
+   *  Key presses of a session, replayed on the cycle they happened.
+   *
+   *  Recording starts from a snapshot of the Chip8 and logs every
+   *  set_key call with its cycle, along with state hash checkpoints
+   *  taken by the caller. Playback restores the snapshot and settings
+   *  and has Chip8::run_until apply the keys at their cycles, however
+   *  the caller steps it and with any engine, so the session repeats
+   *  exactly as fast as the emulator runs headless. Checkpoints that
+   *  don't match the state played back are counted as mismatches.
+   *
+   *  The Chip8 must outlive recording and playback, or stop() them.
+   */
+  class Movie
+  {
+    public:
+      Movie();
+      ~Movie() {stop();}
+
+      void checkpoint();
+      int get_checkpoints() const {return checkpoints;}
+      unsigned long long get_first_mismatch() const {return first_mismatch;}
+      unsigned long long get_length() const;
+      int get_mismatches() const {return mismatches;}
+      unsigned long long get_rom_hash() const {return header.rom_hash;}
+      unsigned long long get_seed() const {return header.seed;}
+      bool is_finished() const;
+      void load(const char* file);
+      void play(Chip8& chip8);
+      void record(Chip8& chip8);
+      void save(const char* file) const;
+      void stop();
+
+      friend class Chip8;
+
+    private:
+      enum MODES {STOPPED, RECORDING, PLAYING};
+
+      /**
+       *  One decoded input entry.
+       */
+      struct Entry
+      {
+        unsigned long long cycle;     // Since the start
+        unsigned char flags;          // Key index, PRESSED and CHECKPOINT
+        unsigned long long hash;      // State hash of a checkpoint
+      };
+
+      MovieHeader header;
+      SaveState start;
+      std::vector<unsigned char> input;
+
+      MODES mode;
+      Chip8* chip8;
+      unsigned long long start_cycle;   // Chip8::get_cycles() at the start
+
+      // Recording, cycle of the last entry
+      unsigned long long last_cycle;
+
+      // Playback, next entry and where the one after it starts in input
+      Entry next;
+      unsigned int position;
+      bool has_next;
+
+      int checkpoints;                  // Recorded or checked
+      int mismatches;
+      unsigned long long first_mismatch;  // Cycle since the start
+
+      Movie(const Movie&);
+      Movie& operator=(const Movie&);
+
+      void append(unsigned long long cycle, unsigned char flags);
+      unsigned long long play_input();
+      bool read_entry(unsigned int& position, unsigned long long previous, Entry& entry) const;
+      bool record_key(unsigned long long cycle, Chip8::EMU_KEYS key, bool pressed);
+  };
+}
+
+#endif
@@ -0,0 +1,27 @@
+#ifndef YACE_OPCODES_H
+#define YACE_OPCODES_H
+
+namespace YACE
+{
+  /**
+   *  Every instruction the CPU knows how to execute.
+   *
+   *  OP_0NNN is any 0x0000 opcode the interpreter doesn't recognize. Those
+   *  are ignored without advancing the program counter. OP_UNKNOWN is any
+   *  other unrecognized opcode, which is skipped.
+   */
+  enum OPCODES {OP_0NNN, OP_00CN, OP_00E0, OP_00EE, OP_00FB, OP_00FC, OP_00FD, OP_00FE, OP_00FF,
+                OP_1NNN, OP_2NNN, OP_3XNN, OP_4XNN, OP_5XY0, OP_6XNN, OP_7XNN,
+                OP_8XY0, OP_8XY1, OP_8XY2, OP_8XY3, OP_8XY4, OP_8XY5, OP_8XY6, OP_8XY7, OP_8XYE,
+                OP_9XY0, OP_ANNN, OP_BNNN, OP_CXNN, OP_DXYN, OP_EX9E, OP_EXA1,
+                OP_FX07, OP_FX0A, OP_FX15, OP_FX18, OP_FX1E, OP_FX29, OP_FX30, OP_FX33,
+                OP_FX55, OP_FX65, OP_FX75, OP_FX85,
+                OP_UNKNOWN, OPCODE_COUNT};
+
+  OPCODES decode_opcode(unsigned short opcode);
+  char* disassemble(unsigned short opcode, char* text, int size);
+  const char* opcode_name(OPCODES instruction);
+  const unsigned char* opcode_table();
+}
+
+#endif
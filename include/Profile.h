@@ -0,0 +1,116 @@
+#ifndef YACE_PROFILE_H
+#define YACE_PROFILE_H
+
+#include <cstdio>
+#include <map>
+#include <vector>
+
+#include "Opcodes.h"
+
+namespace YACE
+{
+  /**
+   *  Execution profile of a game.
+   *
+   *  Counts executed instructions per OPCODES value and per address,
+   *  cycles spent waiting for a key in FX0A and sprite collisions. Cycles
+   *  are also attributed to the current 2NNN/00EE call stack so they can
+   *  be exported as folded stacks for flame graph tools.
+   *
+   *  Runs of two and three instructions at consecutive addresses are
+   *  counted as well, to find the sequences worth fusing into
+   *  superinstructions.
+   */
+  class Profile
+  {
+    public:
+      static const size_t MAX_SEQUENCES_LISTED = 20;  // Sequences in the flat report
+
+      Profile();
+
+      void clear();
+      unsigned long long get_address_count(unsigned int address) const {return addresses[address & 0xFFF];}
+      unsigned long long get_collisions() const {return collisions;}
+      unsigned long long get_cycles() const {return cycles;}
+      unsigned long long get_draws() const {return draws;}
+      unsigned long long get_key_wait_cycles() const {return key_wait_cycles;}
+      unsigned long long get_opcode_count(OPCODES instruction) const {return opcodes[instruction];}
+      unsigned long long get_sequence_count(OPCODES first, OPCODES second) const;
+      unsigned long long get_sequence_count(OPCODES first, OPCODES second, OPCODES third) const;
+      void record(unsigned int address, unsigned short opcode, unsigned int program_counter,
+                  unsigned int stack_size, bool collision);
+      void write_flat(FILE* output) const;
+      void write_folded(FILE* output) const;
+
+    private:
+      /**
+       *  Node of the call tree.
+       */
+      struct Frame
+      {
+        unsigned int address;     // Subroutine address, 0 for the root
+        unsigned int depth;       // Stack size inside the subroutine
+        int parent;
+        unsigned long long cycles;
+      };
+
+      unsigned long long cycles;
+      unsigned long long opcodes[OPCODE_COUNT];
+      unsigned long long addresses[0x1000];
+      unsigned short last_opcode[0x1000];  // Opcode last executed at each address
+      unsigned long long key_wait_cycles;
+      unsigned long long draws;
+      unsigned long long collisions;
+
+      std::map<unsigned int, unsigned long long> sequences;  // Packed OPCODES values to count
+      unsigned int last_address;  // Address of the previous instruction
+      unsigned int run;           // Packed OPCODES values of the current run, the latest lowest
+      int run_length;
+
+      std::vector<Frame> frames;
+      std::map<unsigned long long, int> children;  // (parent << 12 | address) to frame
+      int frame;                // Current frame
+      unsigned int depth;       // Stack size after the last instruction
+
+      void call(unsigned int address, unsigned int depth);
+      void count_sequence(OPCODES instruction, unsigned int address);
+      void write_stack(FILE* output, int frame) const;
+  };
+
+  /**
+   *  Counts one executed instruction. program_counter, stack_size and
+   *  collision are the CPU state after it was executed.
+   */
+  inline void Profile::record(unsigned int address, unsigned short opcode, unsigned int program_counter,
+                              unsigned int stack_size, bool collision)
+  {
+    OPCODES instruction = OPCODES(opcode_table()[opcode]);
+
+    cycles++;
+    opcodes[instruction]++;
+    addresses[address & 0xFFF]++;
+    last_opcode[address & 0xFFF] = opcode;
+    frames[frame].cycles++;
+
+    if (instruction == OP_DXYN)
+    {
+      draws++;
+      collisions += collision;
+    }
+    else if (instruction == OP_FX0A && program_counter == address)
+      key_wait_cycles++;
+
+    count_sequence(instruction, address);
+
+    if (stack_size > depth)
+      call(program_counter, stack_size);
+
+    // Returns, or the stack being reset
+    while (frame && frames[frame].depth > stack_size)
+      frame = frames[frame].parent;
+
+    depth = stack_size;
+  }
+}
+
+#endif
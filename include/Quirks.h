@@ -0,0 +1,61 @@
+#ifndef YACE_QUIRKS_H
+#define YACE_QUIRKS_H
+
+namespace YACE
+{
+  /**
+   *  Opcode behaviours that differ between Chip-8 interpreters.
+   *
+   *  Every profile is a type holding the same constants. The CPU engines
+   *  are templates instantiated once per profile, so quirks cost nothing
+   *  at run time. QUIRKS_DEFAULT is the behaviour YACE always had.
+   */
+  enum QUIRK_PROFILES {QUIRKS_DEFAULT, QUIRKS_CHIP8, QUIRKS_SUPERCHIP, QUIRKS_MODERN, QUIRK_PROFILE_COUNT};
+
+  struct DefaultQuirks
+  {
+    static const bool SHIFT_VY = false;       // 8XY6/8XYE shift VY into VX instead of shifting VX
+    static const bool INCREMENT_I = true;     // FX55/FX65 leave I past the last register
+    static const bool JUMP_VX = false;        // BNNN jumps to NNN + VX instead of NNN + V0
+    static const bool ADD_I_OVERFLOW = true;  // FX1E sets VF when I passes 0xFFF
+    static const bool WRAP_SPRITES = false;   // Sprites wrap around the screen instead of being clipped
+  };
+
+  /**
+   *  The original COSMAC VIP interpreter.
+   */
+  struct Chip8Quirks
+  {
+    static const bool SHIFT_VY = true;
+    static const bool INCREMENT_I = true;
+    static const bool JUMP_VX = false;
+    static const bool ADD_I_OVERFLOW = false;
+    static const bool WRAP_SPRITES = false;
+  };
+
+  /**
+   *  SuperChip 1.1 on the HP 48.
+   */
+  struct SuperChipQuirks
+  {
+    static const bool SHIFT_VY = false;
+    static const bool INCREMENT_I = false;
+    static const bool JUMP_VX = true;
+    static const bool ADD_I_OVERFLOW = false;
+    static const bool WRAP_SPRITES = false;
+  };
+
+  /**
+   *  Octo and XO-CHIP, which most recent games are written for.
+   */
+  struct ModernQuirks
+  {
+    static const bool SHIFT_VY = true;
+    static const bool INCREMENT_I = true;
+    static const bool JUMP_VX = false;
+    static const bool ADD_I_OVERFLOW = false;
+    static const bool WRAP_SPRITES = true;
+  };
+}
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef YACE_RANDOM_H
+#define YACE_RANDOM_H
+
+namespace YACE
+{
+  /**
+   *  PCG32 (XSH RR) generator used by CXNN.
+   *
+   *  The whole state is one 64-bit word, so every instance can own one
+   *  and store it in save states.
+   */
+  class Random
+  {
+    public:
+      static const unsigned long long DEFAULT_SEED = 0x853C49E6748FEA9BULL;
+
+      Random() {seed(DEFAULT_SEED);}
+
+      unsigned long long get_state() const {return state;}
+      unsigned int next();
+      unsigned char next_byte() {return next() >> 24;}
+      void seed(unsigned long long seed);
+      void set_state(unsigned long long state) {this->state = state;}
+
+    private:
+      static const unsigned long long MULTIPLIER = 6364136223846793005ULL;
+      static const unsigned long long INCREMENT = 1442695040888963407ULL;
+
+      unsigned long long state;
+  };
+
+  inline unsigned int Random::next()
+  {
+    unsigned long long old = state;
+    state = old * MULTIPLIER + INCREMENT;
+
+    unsigned int shifted = ((old >> 18) ^ old) >> 27;
+    unsigned int rotation = old >> 59;
+
+    return (shifted >> rotation) | (shifted << (-rotation & 31));
+  }
+
+  inline void Random::seed(unsigned long long seed)
+  {
+    state = 0;
+    next();
+    state += seed;
+    next();
+  }
+}
+
+#endif
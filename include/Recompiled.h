@@ -0,0 +1,65 @@
+#ifndef YACE_RECOMPILED_H
+#define YACE_RECOMPILED_H
+
+#include <vector>
+
+#include "JIT.h"
+#include "Quirks.h"
+
+namespace YACE
+{
+  /**
+   *  A game translated to C++ ahead of time by yace-recompile.
+   */
+  struct RecompiledProgram
+  {
+    const unsigned char* image;       // Game the blocks were translated from, loaded at 0x200
+    int length;
+    QUIRK_PROFILES quirks;            // Profile the blocks follow
+    const JIT::Block* blocks;         // Sorted by start address
+    int block_count;
+  };
+
+  /**
+   *  Blocks of the running game translated ahead of time.
+   *
+   *  Generated programs linked into the executable register themselves
+   *  with add(). The first time a block is requested after a flush, the
+   *  program matching the game in memory and the quirk profile is looked
+   *  up. A block is only used while the memory it was translated from is
+   *  unchanged, so self-modified code is left to the interpreter.
+   */
+  class Recompiled
+  {
+    public:
+      static const int MAX_BLOCK_LENGTH = 64;   // Opcodes in the longest block
+
+      Recompiled();
+      Recompiled(const Recompiled& other);
+
+      Recompiled& operator=(const Recompiled& other);
+
+      static bool add(const RecompiledProgram* program);
+
+      void flush();
+      const JIT::Block* get_block(const unsigned char* memory, unsigned int address);
+      bool is_resolved() const {return resolved;}
+      void invalidate(unsigned int address, unsigned int length);
+      void set_quirks(QUIRK_PROFILES quirks);
+
+    private:
+      enum BLOCK_STATES {BLOCK_UNCHECKED, BLOCK_VALID, BLOCK_STALE};
+
+      const RecompiledProgram* program;   // 0 if no program matched
+      bool resolved;                      // program has been looked up
+      QUIRK_PROFILES quirks;
+      std::vector<short> index;           // Block starting at each address, -1 if none
+      std::vector<unsigned char> states;  // BLOCK_STATES of every block
+
+      static std::vector<const RecompiledProgram*>& programs();
+
+      void resolve(const unsigned char* memory);
+  };
+}
+
+#endif
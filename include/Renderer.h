@@ -0,0 +1,46 @@
+#ifndef YACE_RENDERER_H
+#define YACE_RENDERER_H
+
+#include "Framebuffer.h"
+
+namespace YACE
+{
+  /**
+   *  Converts a framebuffer to RGBA32 or RGB565 pixels in a buffer owned
+   *  by the caller, scaled by a whole number from 1 to 8.
+   *
+   *  Pixels are 32 or 16-bit values in native byte order, RGBA32 colors
+   *  are written as 0xRRGGBBAA. Every line of the screen is expanded once,
+   *  with SSE2 or AVX2 when the CPU has it, and copied to the other lines
+   *  of its scaled row. Nothing is allocated while rendering.
+   */
+  class Renderer
+  {
+    public:
+      enum FORMATS {RGBA32, RGB565};
+
+      static const int MAX_SCALE = 8;
+
+      Renderer();
+
+      FORMATS get_format() const {return format;}
+      int get_pixel_size() const {return format == RGBA32 ? 4 : 2;}
+      int get_scale() const {return scale;}
+      void render(const Framebuffer& video, void* destination, int pitch, unsigned long long rows = ~0ULL) const;
+      void set_format(FORMATS format);
+      void set_palette(unsigned int off, unsigned int on);
+      void set_scale(int scale);
+
+    private:
+      // Writes 8 pixels per byte of bits, most significant bit first
+      typedef void (*Expander)(const unsigned char* bits, int count, void* destination, const unsigned int* palette);
+
+      FORMATS format;
+      int scale;
+      unsigned int palette[2];          // Off and on colors
+      unsigned long long spread[256];   // Every bit of a byte repeated scale times
+      Expander expand;
+  };
+}
+
+#endif
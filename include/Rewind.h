@@ -0,0 +1,71 @@
+#ifndef YACE_REWIND_H
+#define YACE_REWIND_H
+
+#include <deque>
+
+#include "SaveState.h"
+
+namespace YACE
+{
+  class Chip8;
+
+  /**
+   *  History of save states for stepping an emulator back in time.
+   *
+   *  Every snapshot is stored as the XOR of its SaveState with the last
+   *  keyframe, run-length encoded so unchanged bytes take no space.
+   *  Keyframes are encoded the same way against an all-zero state. All
+   *  snapshots share one buffer of a fixed size, and the oldest keyframe
+   *  and its snapshots are dropped when it is full. Restoring decodes at
+   *  most two snapshots.
+   */
+  class Rewind
+  {
+    public:
+      Rewind(unsigned int budget, int keyframe_interval = 60);
+      ~Rewind();
+
+      void clear();
+      int get_count() const {return entries.size();}
+      unsigned long long get_cycle(int age) const {return entries[entries.size() - 1 - age].cycle;}
+      unsigned int get_used() const {return used;}
+      void push(Chip8& chip8);
+      bool restore(Chip8& chip8, int age);
+      bool rewind(Chip8& chip8, int age);
+
+    private:
+      struct Entry
+      {
+        unsigned long long sequence;      // Snapshots pushed before this one
+        unsigned long long key_sequence;  // Sequence of its keyframe
+        unsigned long long cycle;         // Chip8::get_cycles() when taken
+        unsigned int offset;              // Encoded snapshot in data
+        unsigned int size;
+      };
+
+      unsigned char* data;
+      unsigned int budget;
+      unsigned int head;                  // Where the next snapshot goes
+      unsigned int used;
+      unsigned char* scratch;             // Snapshot being encoded
+
+      std::deque<Entry> entries;          // Oldest first
+      unsigned long long next_sequence;
+
+      // Last keyframe, which new snapshots are encoded against
+      SaveState key;
+      bool has_key;
+      unsigned long long key_sequence;
+      int keyframe_interval;
+      int since_key;                      // Snapshots pushed since the keyframe
+
+      unsigned int allocate(unsigned int size);
+      void decode(const Entry& entry, SaveState& state) const;
+      void drop_oldest();
+
+      Rewind(const Rewind&);
+      Rewind& operator=(const Rewind&);
+  };
+}
+
+#endif
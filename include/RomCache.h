@@ -0,0 +1,46 @@
+#ifndef YACE_ROM_CACHE_H
+#define YACE_ROM_CACHE_H
+
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace YACE
+{
+  /**
+   *  Contents of a game, shared by every instance running it.
+   */
+  struct Rom
+  {
+    unsigned long long hash;          // 64-bit FNV-1a of the contents
+    const unsigned char* data;
+    int length;                       // At most 0xE00 bytes
+  };
+
+  /**
+   *  Process-wide cache of games keyed by content hash.
+   *
+   *  A file is read once into memory, later loads of the same path or of
+   *  a file with the same contents share that copy. Roms stay loaded
+   *  until clear() and keep the contents read, even if their files
+   *  change. All methods may be called from any thread.
+   */
+  class RomCache
+  {
+    public:
+      static void clear();
+      static unsigned long long hash(const unsigned char* data, int length);
+      static std::shared_ptr<const Rom> load(const char* file);
+      static std::shared_ptr<const Rom> load(const unsigned char* data, int length);
+
+    private:
+      static std::mutex mutex;
+      static std::map<unsigned long long, std::shared_ptr<const Rom> > roms;
+      static std::map<std::string, std::shared_ptr<const Rom> > files;
+
+      static std::shared_ptr<const Rom> insert(const std::shared_ptr<const Rom>& rom);
+  };
+}
+
+#endif
@@ -0,0 +1,77 @@
+#ifndef YACE_SAVE_STATE_H
+#define YACE_SAVE_STATE_H
+
+namespace YACE
+{
+  /**
+   *  Complete state of a Chip8 and its CPU.
+   *
+   *  The layout is fixed and contains no pointers, so a state is saved
+   *  and restored with a single copy and can be used straight from a
+   *  memory mapped file. Values are stored in host byte order. Increment
+   *  VERSION whenever the layout changes.
+   */
+  struct SaveState
+  {
+    static const unsigned int MAGIC = 0x45434159;    // "YACE"
+    static const unsigned int VERSION = 2;
+
+    unsigned int magic;
+    unsigned int version;
+    unsigned int size;                  // sizeof(SaveState)
+
+    // CPU
+    unsigned int program_counter;
+    unsigned int stack[16];
+    unsigned int stack_size;
+
+    // Timers
+    unsigned int delay_timer;
+    unsigned int sound_timer;
+
+    // Registers
+    unsigned short I;
+    unsigned char V[16];
+    unsigned char RPL[8];
+
+    // Input
+    unsigned char keys[16];
+    unsigned char key_is_pressed;
+    unsigned char last_key_pressed;
+
+    unsigned char video_mode;
+    unsigned char reserved[7];          // Zero, keeps video 8-byte aligned
+
+    unsigned long long random;          // CXNN generator state
+
+    // Rows as two 64-bit words, left half first
+    unsigned long long video[64][2];
+    unsigned char memory[0x1000];
+
+    bool is_valid() const;
+  };
+
+  static_assert(sizeof(SaveState) == 0x1498, "SaveState layout changed");
+
+  /**
+   *  Checks the header and every value used as an address or index, so
+   *  a state read from a file can't make the emulator read out of bounds.
+   *  I may hold any value, as memory accesses through it wrap around.
+   */
+  inline bool SaveState::is_valid() const
+  {
+    if (magic != MAGIC || version != VERSION || size != sizeof(SaveState))
+      return false;
+
+    if (program_counter >= 0x1000 || stack_size > 16 || last_key_pressed >= 16 || video_mode > 1)
+      return false;
+
+    for (unsigned int i = 0; i < stack_size; i++)
+      if (stack[i] >= 0x1000)
+        return false;
+
+    return true;
+  }
+}
+
+#endif
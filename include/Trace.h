@@ -0,0 +1,91 @@
+#ifndef YACE_TRACE_H
+#define YACE_TRACE_H
+
+#include <atomic>
+
+namespace YACE
+{
+  /**
+   *  One executed instruction.
+   */
+  struct TraceRecord
+  {
+    unsigned int cycle;               // Lower 32 bits of the instruction count
+    unsigned short program_counter;
+    unsigned short opcode;
+    unsigned short I;                 // I after the instruction
+    unsigned short changed;           // Bit r is set if Vr changed
+    unsigned char value;              // VX after the instruction
+    unsigned char reserved[3];
+  };
+
+  /**
+   *  Header of a saved trace, followed by count records oldest first.
+   */
+  struct TraceHeader
+  {
+    static const unsigned int MAGIC = 0x43525459;    // "YTRC"
+    static const unsigned int VERSION = 1;
+
+    unsigned int magic;
+    unsigned int version;
+    unsigned int record_size;         // sizeof(TraceRecord)
+    unsigned int count;
+  };
+
+  /**
+   *  Fixed-size ring buffer of executed instructions.
+   *
+   *  The CPU is the only writer. Readers on other threads may copy the
+   *  newest records at any time without locking; records overwritten
+   *  while being copied are dropped.
+   */
+  class Trace
+  {
+    public:
+      Trace(int capacity);
+      ~Trace();
+
+      void clear() {count.store(0, std::memory_order_release);}
+      int get_capacity() const {return mask + 1;}
+      unsigned long long get_count() const {return count.load(std::memory_order_acquire);}
+      int read(TraceRecord* destination, int maximum) const;
+      void record(unsigned int program_counter, unsigned short opcode, short I,
+                  const char* before, const char* after);
+      void save(const char* file) const;
+
+    private:
+      TraceRecord* records;
+      unsigned int mask;
+      std::atomic<unsigned long long> count;  // Records written since clear()
+
+      Trace(const Trace&);
+      Trace& operator=(const Trace&);
+  };
+
+  /**
+   *  Appends an instruction. before and after are V before and after it
+   *  was executed.
+   */
+  inline void Trace::record(unsigned int program_counter, unsigned short opcode, short I,
+                            const char* before, const char* after)
+  {
+    unsigned long long index = count.load(std::memory_order_relaxed);
+    TraceRecord& record = records[index & mask];
+    unsigned short changed = 0;
+
+    for (int r = 0; r < 16; r++)
+      changed |= (before[r] != after[r]) << r;
+
+    record.cycle = index;
+    record.program_counter = program_counter;
+    record.opcode = opcode;
+    record.I = I;
+    record.changed = changed;
+    record.value = after[(opcode & 0x0F00) >> 8];
+
+    count.store(index + 1, std::memory_order_release);
+  }
+}
+
+#endif
@@ -0,0 +1,94 @@
+#ifndef YACE_VIDEO_STREAM_H
+#define YACE_VIDEO_STREAM_H
+
+#include <functional>
+#include <vector>
+
+#include "Framebuffer.h"
+
+namespace YACE
+{
+  /**
+   *  Format of the stream written by VideoEncoder.
+   *
+   *  The stream starts with MAGIC and VERSION, followed by one packet per
+   *  frame. A packet is a flags byte, then unless the frame is UNCHANGED
+   *  a little-endian mask of the rows that differ from the previous frame
+   *  (4 bytes in Chip-8 mode, 8 in SuperChip mode). Each of those rows is
+   *  sent as its XOR with the previous frame: a little-endian mask of its
+   *  non-zero bytes (1 or 2 bytes) followed by those bytes, leftmost
+   *  first. Keyframes are encoded against a blank screen.
+   */
+  namespace VideoFormat
+  {
+    const unsigned char MAGIC[4] = {'Y', 'V', 'I', 'D'};
+    const unsigned char VERSION = 1;
+    const int HEADER_SIZE = 5;
+
+    enum FLAGS {KEYFRAME = 1, SUPERCHIP = 2, UNCHANGED = 4};
+
+    // Flags, row mask and every row with all its bytes
+    const int MAX_PACKET_SIZE = 1 + 8 + 64 * (2 + 16);
+  }
+
+  /**
+   *  Encodes successive frames of a screen into a compact byte stream.
+   *
+   *  Only the rows changed since the last frame are sent, with their
+   *  unchanged bytes left out. A keyframe is sent first, after every mode
+   *  switch, every keyframe_interval frames (never if 0) and when one is
+   *  requested, for example when a client connects. Each packet is passed
+   *  to the sink in one call.
+   */
+  class VideoEncoder
+  {
+    public:
+      typedef std::function<void(const unsigned char* data, unsigned int size)> Sink;
+
+      VideoEncoder(const Sink& sink, int keyframe_interval = 600);
+
+      static Sink descriptor_sink(int descriptor);
+      static Sink memory_sink(std::vector<unsigned char>& buffer);
+
+      void encode(const Framebuffer& video);
+      unsigned long long get_bytes() const {return bytes;}
+      unsigned long long get_frames() const {return frames;}
+      void request_keyframe() {keyframe_requested = true;}
+
+    private:
+      Sink sink;
+      Framebuffer::Row rows[64];    // Visible pixels of the last frame
+      Framebuffer::MODES mode;
+      int keyframe_interval;
+      int since_key;                // Frames sent since the last keyframe
+      bool started;                 // Header sent
+      bool keyframe_requested;
+
+      unsigned long long frames;
+      unsigned long long bytes;     // Bytes passed to the sink, including the header
+      unsigned char packet[VideoFormat::HEADER_SIZE + VideoFormat::MAX_PACKET_SIZE];
+  };
+
+  /**
+   *  Rebuilds the frames of a stream written by VideoEncoder.
+   */
+  class VideoDecoder
+  {
+    public:
+      VideoDecoder();
+
+      unsigned int decode(const unsigned char* data, unsigned int size);
+      unsigned long long get_frames() const {return frames;}
+      Framebuffer& get_framebuffer() {return video;}
+
+    private:
+      Framebuffer video;
+      Framebuffer::Row rows[64];
+      Framebuffer::MODES mode;
+      bool started;                 // Header read
+      bool keyed;                   // A keyframe was decoded
+      unsigned long long frames;
+  };
+}
+
+#endif
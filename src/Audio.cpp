@@ -0,0 +1,146 @@
+#include <cstring>
+
+#include "../include/Audio.h"
+#include "../include/Chip8.h"
+
+namespace YACE
+{
+  Audio::Audio(Chip8& chip8, unsigned int sample_rate) : chip8(chip8), sample_rate(sample_rate), samples(0)
+  {
+    if (sample_rate == 0)
+      throw "Invalid sample rate!";
+
+    set_tone(440, 8192);
+    sync();
+  }
+
+  /*
+   *  Private methods
+   */
+  /**
+   *  Returns the first sample due at or after cycle.
+   */
+  unsigned long long Audio::sample_at(unsigned long long cycle) const
+  {
+    if (cycle <= base_cycle)
+      return base_sample;
+
+    unsigned __int128 scaled = (unsigned __int128)(cycle - base_cycle) * sample_rate;
+    return base_sample + (unsigned long long)((scaled + cpu_frequency - 1) / cpu_frequency);
+  }
+
+  /**
+   *  Continues from the current cycle at a new CPU frequency.
+   */
+  void Audio::rebase()
+  {
+    base_sample = sample_at(chip8.get_cycles());
+    base_cycle = chip8.get_cycles();
+    cpu_frequency = chip8.get_cpu_frequency();
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Writes up to maximum of the samples due to destination and returns
+   *  the number written.
+   */
+  int Audio::generate(short* destination, int maximum)
+  {
+    if (chip8.get_cpu_frequency() != cpu_frequency)
+      rebase();
+
+    unsigned long long pending = sample_at(chip8.get_cycles()) - samples;
+    int count = pending < (unsigned long long)maximum ? pending : maximum;
+    unsigned long long end = samples + count;
+    unsigned long long event_count = chip8.get_sound_event_count();
+
+    // Older events were overwritten
+    if (event_count - events > (unsigned long long)Chip8::SOUND_EVENTS)
+    {
+      events = event_count;
+      on = chip8.get_sound_timer() > 0;
+    }
+
+    while (samples < end)
+    {
+      unsigned long long until = end;
+
+      if (events < event_count)
+      {
+        const Chip8::SoundEvent& event = chip8.get_sound_event(events);
+        unsigned long long start = sample_at(event.cycle);
+
+        if (start <= samples)
+        {
+          // Every beep starts at the same phase
+          if (event.on && !on)
+            phase = 0;
+
+          on = event.on;
+          events++;
+          continue;
+        }
+
+        if (start < until)
+          until = start;
+      }
+
+      int length = until - samples;
+
+      if (!on)
+        std::memset(destination, 0, length * sizeof(short));
+      else
+      {
+        for (int i = 0; i < length; i++)
+        {
+          destination[i] = phase & 0x80000000 ? -amplitude : amplitude;
+          phase += phase_step;
+        }
+      }
+
+      destination += length;
+      samples = until;
+    }
+
+    return count;
+  }
+
+  /**
+   *  Returns the number of samples due.
+   */
+  int Audio::get_pending()
+  {
+    if (chip8.get_cpu_frequency() != cpu_frequency)
+      rebase();
+
+    return sample_at(chip8.get_cycles()) - samples;
+  }
+
+  /**
+   *  Sets the frequency in Hz and the amplitude of the square wave.
+   */
+  void Audio::set_tone(unsigned int frequency, short amplitude)
+  {
+    if (frequency == 0 || frequency >= sample_rate)
+      throw "Invalid tone!";
+
+    phase_step = ((unsigned long long)frequency << 32) / sample_rate;
+    this->amplitude = amplitude;
+  }
+
+  /**
+   *  Drops the samples due, the next ones start at the current cycle.
+   *  Used after the emulator ran without taking samples.
+   */
+  void Audio::sync()
+  {
+    base_cycle = chip8.get_cycles();
+    base_sample = samples;
+    cpu_frequency = chip8.get_cpu_frequency();
+    events = chip8.get_sound_event_count();
+    on = chip8.get_sound_timer() > 0;
+    phase = 0;
+  }
+}
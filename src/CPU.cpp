@@ -1,10 +1,32 @@
 #include "../include/CPU.h"
 #include "../include/Chip8.h"
+#include "../include/Opcodes.h"
 
 namespace YACE
 {
-  CPU::CPU(Chip8& chip8) : chip8(chip8), opcode(0), stack(), I(0), program_counter(0x200)
+  const CPU::QuirkEngines CPU::QUIRK_ENGINES[QUIRK_PROFILE_COUNT] =
   {
+    {&CPU::interpret<DefaultQuirks>, &CPU::execute_threaded<DefaultQuirks>, &CPU::execute_dynarec<DefaultQuirks>,
+     &CPU::execute_recompiled<DefaultQuirks>, DefaultQuirks::SHIFT_VY},
+    {&CPU::interpret<Chip8Quirks>, &CPU::execute_threaded<Chip8Quirks>, &CPU::execute_dynarec<Chip8Quirks>,
+     &CPU::execute_recompiled<Chip8Quirks>, Chip8Quirks::SHIFT_VY},
+    {&CPU::interpret<SuperChipQuirks>, &CPU::execute_threaded<SuperChipQuirks>, &CPU::execute_dynarec<SuperChipQuirks>,
+     &CPU::execute_recompiled<SuperChipQuirks>, SuperChipQuirks::SHIFT_VY},
+    {&CPU::interpret<ModernQuirks>, &CPU::execute_threaded<ModernQuirks>, &CPU::execute_dynarec<ModernQuirks>,
+     &CPU::execute_recompiled<ModernQuirks>, ModernQuirks::SHIFT_VY}
+  };
+
+  CPU::CPU(Chip8& chip8) : chip8(chip8), engine(THREADED), quirks(QUIRKS_DEFAULT), engines(&QUIRK_ENGINES[QUIRKS_DEFAULT]),
+                           opcode(0), stack_size(0), I(0), program_counter(0x200)
+  {
+#ifdef YACE_INSTRUMENTED
+    trace = 0;
+    profile = 0;
+#endif
+    cycles_left = 0;
+    interpret_end = 0;
+    probing = false;
+    idle_countdown = IDLE_CHECK_INTERVAL;
     reset();
   }
 
@@ -46,12 +68,16 @@ namespace YACE
       case 0xFF:  // Enable extended screen mode
         opcode0x00FF(opcode);
         break;
+      default:    // Unknown opcodes don't advance the program counter
+        stall();
+        break;
     }
   }
 
   /**
    *  Takes care of all 0x8000 opcodes.
    */
+  template <typename Quirks>
   void CPU::handleOpcodes0x8000(unsigned short opcode)
   {
     switch (opcode & 0x000F)
@@ -75,13 +101,13 @@ namespace YACE
         opcode0x8XY5(opcode);
         break;
       case 0x6: // VX = VX >> 1, VF = Carry
-        opcode0x8XY6(opcode);
+        opcode0x8XY6<Quirks>(opcode);
         break;
       case 0x7: // VX = VY - VX, VF = !Borrow
         opcode0x8XY7(opcode);
         break;
       case 0xE: // VX = VX << 1, VF = Carry
-        opcode0x8XYE(opcode);
+        opcode0x8XYE<Quirks>(opcode);
         break;
     }
     program_counter += 2;
@@ -103,6 +129,7 @@ namespace YACE
   /**
    *  Takes care of all 0xF000 opcodes.
    */
+  template <typename Quirks>
   void CPU::handleOpcodes0xF000(unsigned short opcode)
   {
     switch (opcode & 0x00FF)
@@ -120,7 +147,7 @@ namespace YACE
         opcode0xFX18(opcode);
         break;
       case 0x1E:  // I = I + VX
-        opcode0xFX1E(opcode);
+        opcode0xFX1E<Quirks>(opcode);
         break;
       case 0x29:  // Point I to 5-byte font sprite for hex character VX
         opcode0xFX29(opcode);
@@ -132,10 +159,10 @@ namespace YACE
         opcode0xFX33(opcode);
         break;
       case 0x55:  // Stores V0..VX in memory starting at I
-        opcode0xFX55(opcode);
+        opcode0xFX55<Quirks>(opcode);
         break;
       case 0x65:  // Reads V0..VX from memory starting at I
-        opcode0xFX65(opcode);
+        opcode0xFX65<Quirks>(opcode);
         break;
       case 0x75:  // Stores V0..VX in RPL user flags (X <= 7)
         opcode0xFX75(opcode);
@@ -154,17 +181,7 @@ namespace YACE
   {
     int lines = opcode & 0x000F;
 
-    int width = 64 << chip8.video_mode;
-    int video_length = width * (32 << chip8.video_mode);
-
-    int data_destination = width * lines;
-    int data_length = video_length - data_destination;
-
-    print_debug("Scrolls display %i lines down.\n", lines);
-
-    std::memmove(chip8.video + data_destination, chip8.video, data_length);
-    std::memset(chip8.video, 0, data_destination);
-
+    chip8.video.scroll_down(lines);
     program_counter += 2;
   }
 
@@ -173,8 +190,7 @@ namespace YACE
    */
   void CPU::opcode0x00E0(unsigned short opcode)
   {
-    print_debug("Clears the screen.\n");
-    std::memset(chip8.video, 0, 0x2000);
+    chip8.video.clear();
     program_counter += 2;
   }
 
@@ -183,12 +199,8 @@ namespace YACE
    */
   void CPU::opcode0x00EE(unsigned short opcode)
   {
-    print_debug("Returns from subroutine.\n");
-    if (!stack.empty())
-    {
-      program_counter = stack.top() + 2;
-      stack.pop();
-    }
+    if (stack_size > 0)
+      program_counter = stack[--stack_size] + 2;
     else
       program_counter += 2;
   }
@@ -198,22 +210,7 @@ namespace YACE
    */
   void CPU::opcode0x00FB(unsigned short opcode)
   {
-    print_debug("Scrolls display 4 pixles right.\n");
-
-    int width = 64 << chip8.video_mode;
-    int height = 32 << chip8.video_mode;
-    int scroll_width = 2 << chip8.video_mode;
-    char* video_length = chip8.video + (width * height);  // End of video memory
-
-    for (char* line = chip8.video; line < video_length; line += width)
-    {
-      // Move line 4 pixels right
-      std::memmove(line + scroll_width, line, width - scroll_width);
-      
-      // Clear the first 4 pixels on line
-      std::memset(line, 0, scroll_width);
-    }
-
+    chip8.video.scroll_right();
     program_counter += 2;
   }
 
@@ -222,22 +219,7 @@ namespace YACE
    */
   void CPU::opcode0x00FC(unsigned short opcode)
   {
-    print_debug("Scrolls display 4 pixles left.\n");
-
-    int width = 64 << chip8.video_mode;
-    int height = 32 << chip8.video_mode;
-    int scroll_width = 2 << chip8.video_mode;
-    char* video_length = chip8.video + (width * height);  // End of video memory
-
-    for (char* line = chip8.video; line < video_length; line += width)
-    {
-      // Move line 4 pixels left
-      std::memmove(line, line + scroll_width, width - scroll_width);
-
-      // Clear the last 4 pixels on line
-      std::memset(line + (width - scroll_width), 0, scroll_width);
-    }
-
+    chip8.video.scroll_left();
     program_counter += 2;
   }
 
@@ -246,8 +228,6 @@ namespace YACE
    */
   void CPU::opcode0x00FD(unsigned short opcode)
   {
-    print_debug("Exit CHIP interpreter.\n");
-
     chip8.reset();  // Reconsider...
     program_counter += 2;
   }
@@ -257,9 +237,7 @@ namespace YACE
    */
   void CPU::opcode0x00FE(unsigned short opcode)
   {
-    print_debug("Disable extended screen mode.\n");
-
-    chip8.video_mode = chip8.CHIP8;
+    chip8.video.set_mode(Framebuffer::CHIP8);
 
     program_counter += 2;
   }
@@ -269,9 +247,7 @@ namespace YACE
    */
   void CPU::opcode0x00FF(unsigned short opcode)
   {
-    print_debug("Enable extended screen mode.\n");
-
-    chip8.video_mode = chip8.SUPERCHIP;
+    chip8.video.set_mode(Framebuffer::SUPERCHIP);
     program_counter += 2;
   }
 
@@ -282,7 +258,9 @@ namespace YACE
   {
     int address = opcode & 0x0FFF;
 
-    print_debug("Jump to address %X.\n", address);
+    if (address <= (int)program_counter && !--idle_countdown)
+      cycles_left -= idle_cycles(program_counter, address, cycles_left - 1);
+
     program_counter = address;
   }
 
@@ -293,11 +271,9 @@ namespace YACE
   {
     int address = opcode & 0x0FFF;
 
-    print_debug("Call subroutine at %X.\n", address);
-
-    if (stack.size() < 16)
+    if (stack_size < 16)
     {
-      stack.push(program_counter);
+      stack[stack_size++] = program_counter;
       program_counter = address;
     }
     else
@@ -312,8 +288,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int value = opcode & 0xFF;
 
-    print_debug("Skips next instruction if V%X [%X] == %.2X.\n", register_x, V[register_x], value);
-
     if ((V[register_x] & 0xFF) == value)
       program_counter += 4;
     else
@@ -328,8 +302,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int value = opcode & 0xFF;
 
-    print_debug("Skips next instruction if V%X [%X] != %.2X.\n", register_x, V[register_x], value);
-
     if ((V[register_x] & 0xFF) != value)
       program_counter += 4;
     else
@@ -344,8 +316,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int register_y = (opcode & 0x00F0) >> 4;
 
-    print_debug("Skip next instruction if V%X == V%X [%X == %X].\n", register_x, register_y,
-                                                                     V[register_x], V[register_y]);
     if ((V[register_x] & 0xFF) == (V[register_y] & 0xFF))
       program_counter += 4;
     else
@@ -360,7 +330,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int value = opcode & 0xFF;
 
-    print_debug("Set V%X to %X.\n", register_x, value);
     V[register_x] = value;
 
     program_counter += 2;
@@ -374,7 +343,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int value = opcode & 0xFF;
 
-    print_debug("Add %X to V%X.\n", value, register_x);
     V[register_x] += value;
 
     program_counter += 2;
@@ -388,8 +356,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int register_y = (opcode & 0x00F0) >> 4;
 
-    print_debug("Set V%X to the value of V%X [%X].\n", register_x, register_y,
-                                                        V[register_y]);
     V[register_x] = V[register_y] & 0xFF;
   }
 
@@ -401,8 +367,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int register_y = (opcode & 0x00F0) >> 4;
 
-    print_debug("Set V%X to V%X OR V%X [%X | %X].\n", register_x, register_x, register_y,
-                                            V[register_x], V[register_y]);
     V[register_x] |= (V[register_y] & 0xFF);
   }
 
@@ -414,8 +378,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int register_y = (opcode & 0x00F0) >> 4;
 
-    print_debug("Set V%X to V%X AND V%X [%X & %X].\n", register_x, register_x, register_y,
-                                              V[register_x], V[register_y]);
     V[register_x] &= V[register_y];
   }
 
@@ -427,8 +389,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int register_y = (opcode & 0x00F0) >> 4;
 
-    print_debug("Set V%X to V%X XOR V%X [%X ^ %X].\n", register_x, register_x, register_y,
-                                                        V[register_x], V[register_y]);
     V[register_x] ^= V[register_y];
   }
 
@@ -440,8 +400,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int register_y = (opcode & 0x00F0) >> 4;
 
-    print_debug("Set V%X to V%X + V%X [%X + %X].\n", register_x, register_x, register_y,
-                                                      V[register_x], V[register_y]);
     V[0xF] = ((V[register_x] & 0xFF) + (V[register_y] & 0xFF)) > 0xFF;
     V[register_x] += V[register_y] & 0xFF;
   }
@@ -454,23 +412,21 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int register_y = (opcode & 0x00F0) >> 4;
 
-    print_debug("Set V%X to V%X - V%X [%X - %X].\n", register_x, register_x, register_y,
-                                           V[register_x], V[register_y]);
     V[0xF] = !((V[register_x] & 0xFF) < (V[register_y] & 0xFF));
     V[register_x] -= V[register_y] & 0xFF;
   }
 
   /**
-   *  VX = VX >> 1. VF = Least significant bit.
+   *  VX = VX >> 1, or VY >> 1 with SHIFT_VY. VF = Least significant bit.
    */
+  template <typename Quirks>
   void CPU::opcode0x8XY6(unsigned short opcode)
   {
     int register_x = (opcode & 0x0F00) >> 8;
+    int source = Quirks::SHIFT_VY ? (opcode & 0x00F0) >> 4 : register_x;
 
-    print_debug("Shift V%X right by 1.\n", register_x);
-
-    V[0xF] = V[register_x] & 1;
-    V[register_x] = (V[register_x] & 0xFF) >> 1;
+    V[0xF] = V[source] & 1;
+    V[register_x] = (V[source] & 0xFF) >> 1;
   }
 
   /**
@@ -481,23 +437,21 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int register_y = (opcode & 0x00F0) >> 4;
 
-    print_debug("Set V%X = V%X - V%X [%X - %X].\n", register_x, register_y, register_x,
-                                                    V[register_y], V[register_x]);
     V[0xF] = !(V[register_y] < V[register_x]);
     V[register_x] = (V[register_y] & 0xFF) - (V[register_x] & 0xFF);
   }
 
   /**
-   *  VX = VX << 1. VF = Most significant bit.
+   *  VX = VX << 1, or VY << 1 with SHIFT_VY. VF = Most significant bit.
    */
+  template <typename Quirks>
   void CPU::opcode0x8XYE(unsigned short opcode)
   {
     int register_x = (opcode & 0x0F00) >> 8;
+    int source = Quirks::SHIFT_VY ? (opcode & 0x00F0) >> 4 : register_x;
 
-    print_debug("Shift V%X left by 1.\n", register_x);
-
-    V[0xF] = (V[register_x] & 0xFF) >> 7;
-    V[register_x] = (V[register_x] & 0xFF) << 1;
+    V[0xF] = (V[source] & 0xFF) >> 7;
+    V[register_x] = (V[source] & 0xFF) << 1;
   }
 
   /**
@@ -508,8 +462,6 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int register_y = (opcode & 0x00F0) >> 4;
 
-    print_debug("Skip next instruction if V%X != V%X. [%X != %X]\n", register_x, register_y,
-                                                                     V[register_x], V[register_y]);
     if ((V[register_x] & 0xFF) != (V[register_y] & 0xFF))
       program_counter += 4;
     else
@@ -523,21 +475,21 @@ namespace YACE
   {
     int address = opcode & 0x0FFF;
 
-    print_debug("Set I to the address %.3X.\n", address);
     I = address;
 
     program_counter += 2;
   }
 
   /**
-   *  Jumps to the address NNN + V0.
+   *  Jumps to the address NNN + V0, or NNN + VX with JUMP_VX.
    */
+  template <typename Quirks>
   void CPU::opcode0xBNNN(unsigned short opcode)
   {
     int address = opcode & 0x0FFF;
+    int offset = Quirks::JUMP_VX ? (opcode & 0x0F00) >> 8 : 0;
 
-    print_debug("Jump to address %.3X plus V0 [%X].\n", address, V[0]);
-    program_counter = V[0] + address;
+    program_counter = V[offset] + address;
   }
 
   /**
@@ -548,8 +500,7 @@ namespace YACE
     int register_x = (opcode & 0x0F00) >> 8;
     int value = opcode & 0x00FF;
 
-    print_debug("Set V%X to a random number AND %X.\n", register_x, value);
-    V[register_x] = ((rand() % 0xFF) & 0xFF) & value;
+    V[register_x] = random.next_byte() & value;
 
     program_counter += 2;
   }
@@ -557,50 +508,29 @@ namespace YACE
   /**
    *  Draws a sprite at coordinate (VX, VY).
    */
+  template <typename Quirks>
   void CPU::opcode0xDXYN(unsigned short opcode)
   {
     V[0xF] = 0;
-    int pos_x = V[(opcode & 0x0F00) >> 8];
-    int pos_y = V[(opcode & 0x00F0) >> 4];
+    int pos_x = V[(opcode & 0x0F00) >> 8] & 0xFF;
+    int pos_y = V[(opcode & 0x00F0) >> 4] & 0xFF;
     int lines = opcode & 0x000F;
     int width = 8;
-    int mask = 0x80;
 
     // Draw 16 * 16 sprite (SuperChip mode) or 8 * 16 sprite (Chip-8 mode) if lines == 0
     if (lines == 0)
     {
       lines = 16;
-      width = 8 << chip8.video_mode;
-      
-      print_debug("Draw 16x16 sprite at (%u, %u).\n", pos_x, pos_y);
+      width = 8 << chip8.video.get_mode();
     }
-    else
-      print_debug("Draw sprite at (%u, %u) [%X lines].\n", pos_x, pos_y, lines);
-
-    unsigned char* data_pointer = &chip8.memory[I];
-    unsigned char data;
-
-    for (int y = 0; y < lines; y++)
-    {
-      data = *(data_pointer++);
-
-      for (int x = 0; x < width; x++)
-      {
-        // TODO: Possibly find a better, more generic solution
-        if (x == 8) // Will only happen when drawing a sprite in SuperChip mode
-          data = *(data_pointer++);
-
-        if (data & (mask >> (x % 8)))
-        {
-          int pos = (pos_x + x) + ((pos_y + y) * (64 << chip8.video_mode));
 
-          if (chip8.video[pos])
-            V[0xF] = 1;
+    unsigned char buffer[32];
+    const unsigned char* sprite = sprite_data(I, lines * width / 8, buffer);
 
-          chip8.video[pos] ^= 1;
-        }
-      }
-    }
+    if (Quirks::WRAP_SPRITES)
+      V[0xF] = chip8.video.draw_wrapped_sprite(pos_x, pos_y, sprite, lines, width);
+    else
+      V[0xF] = chip8.video.draw_sprite(pos_x, pos_y, sprite, lines, width);
 
     program_counter += 2;
   }
@@ -612,7 +542,6 @@ namespace YACE
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Skip next instruction if key[%X] is pressed.\n", register_x);
     if (chip8.keys[int(V[register_x])])
       program_counter += 2;
   }
@@ -624,7 +553,6 @@ namespace YACE
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Skip next instruction if key[%X] isn't pressed.\n", register_x);
     if (!chip8.keys[int(V[register_x])])
       program_counter += 2;
   }
@@ -636,7 +564,6 @@ namespace YACE
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Set V%X to the value of the delay timer [%X].\n", register_x, chip8.delay_timer);
     V[register_x] = chip8.delay_timer;
   }
 
@@ -647,14 +574,17 @@ namespace YACE
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Set V%X to awaited key press.\n", register_x);
     if (chip8.key_is_pressed)
     {
       V[register_x] = chip8.last_key_pressed;
       chip8.key_is_pressed = false;
     }
     else
+    {
+      // Keys only change between calls to execute()
       program_counter -= 2;
+      stall();
+    }
   }
 
   /**
@@ -664,7 +594,6 @@ namespace YACE
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Set delay timer to V%X [%X].\n", register_x, V[register_x]);
     chip8.delay_timer = V[register_x];
   }
 
@@ -675,21 +604,24 @@ namespace YACE
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Set sound timer to V%X [%X]\n", register_x, V[register_x]);
-    chip8.sound_timer = V[register_x];
+    // Passes of loop_period() are undone, so they don't start or stop sound
+    if (probing)
+      chip8.sound_timer = V[register_x];
+    else
+      chip8.set_sound_timer(V[register_x], chip8.cycles + interpret_end - cycles_left);
   }
 
   /**
    *  Adds VX to I.
    */
+  template <typename Quirks>
   void CPU::opcode0xFX1E(unsigned short opcode)
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Add V%X [%X] to I [%X]\n", register_x, V[register_x], I);
-
     I += V[register_x];
-    V[0xF] = I > 0xFFF; // Undocumented Chip-8 feature
+    if (Quirks::ADD_I_OVERFLOW)
+      V[0xF] = I > 0xFFF; // Undocumented Chip-8 feature
   }
 
   /**
@@ -699,7 +631,6 @@ namespace YACE
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Point I to 5-byte font sprite for hex character V%X [%X].\n", register_x, V[register_x]);
     I = chip8.FONT_CHIP8 + (V[register_x] * 5);
   }
 
@@ -710,8 +641,6 @@ namespace YACE
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Point I to 10-byte font sprite for digit V%X [%X].\n", register_x, V[register_x]);
-
     I = chip8.FONT_SUPERCHIP + (V[register_x] * 10);
   }
 
@@ -722,40 +651,41 @@ namespace YACE
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Stores the BCD representation of V%X [%X] in I, I+1, I+2.\n", register_x, V[register_x]);
-    chip8.memory[I] = V[register_x] / 100;
-    chip8.memory[I + 1] = (V[register_x] / 10) % 10;
-    chip8.memory[I + 2] = V[register_x] % 10;
+    chip8.memory[I & 0xFFF] = V[register_x] / 100;
+    chip8.memory[(I + 1) & 0xFFF] = (V[register_x] / 10) % 10;
+    chip8.memory[(I + 2) & 0xFFF] = V[register_x] % 10;
+    memory_written(I & 0xFFF, 3);
   }
 
   /**
    *  Stores V0 to VX in memory starting at address I.
    */
+  template <typename Quirks>
   void CPU::opcode0xFX55(unsigned short opcode)
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Stores V0..V%X in memory starting at I [%X].\n", register_x, I);
-
     for (int i = 0; i <= register_x; i++)
-      chip8.memory[I + i] = V[i];
+      chip8.memory[(I + i) & 0xFFF] = V[i];
 
-    I += register_x + 1;
+    memory_written(I & 0xFFF, register_x + 1);
+    if (Quirks::INCREMENT_I)
+      I += register_x + 1;
   }
 
   /**
    *  Fills V0 to VX with values from memory starting at address I.
    */
+  template <typename Quirks>
   void CPU::opcode0xFX65(unsigned short opcode)
   {
     int register_x = (opcode & 0x0F00) >> 8;
 
-    print_debug("Reads V0..V%X from memory starting at I [%X].\n", register_x, I);
-
     for (int i = 0; i <= register_x; i++)
-      V[i] = chip8.memory[I + i];
+      V[i] = chip8.memory[(I + i) & 0xFFF];
 
-    I += register_x + 1;
+    if (Quirks::INCREMENT_I)
+      I += register_x + 1;
   }
 
   /**
@@ -765,8 +695,6 @@ namespace YACE
   {
     int register_x = (opcode & 0xF00) >> 8;
 
-    print_debug("Stores V0 to V%X in RPL user flags\n", register_x);
-
     for (int i = 0; i <= register_x; i++)
       RPL[i] = V[i];
   }
@@ -778,22 +706,20 @@ namespace YACE
   {
     int register_x = (opcode & 0xF00) >> 8;
 
-    print_debug("Reads V0 to V%X from RPL user flags\n", register_x);
-
     for (int i = 0; i <= register_x; i++)
       V[i] = RPL[i];
   }
 
-  /*
-   *  Public methods
+  /**
+   *  Executes opcodes one at a time through the opcode functions.
    */
-  void CPU::execute(int cycles)
+  template <typename Quirks>
+  void CPU::interpret(int cycles)
   {
-    for (int i = cycles; i > 0; i--)
+    for (cycles_left = cycles; cycles_left > 0; cycles_left--)
     {
-      opcode = (chip8.memory[program_counter] << 8) | chip8.memory[program_counter + 1];
+      opcode = (chip8.memory[program_counter & 0xFFF] << 8) | chip8.memory[(program_counter + 1) & 0xFFF];
 
-      print_debug("(%.4X) ", opcode);
       switch(opcode & 0xF000)
       {
         case 0x0000:  // Clear screen | Return from a subroutine
@@ -821,7 +747,7 @@ namespace YACE
           opcode0x7XNN(opcode);
           break;
         case 0x8000:  // Bit operations
-          handleOpcodes0x8000(opcode);
+          handleOpcodes0x8000<Quirks>(opcode);
           break;
         case 0x9000:  // Skip next instruction if VX != VY
           opcode0x9XY0(opcode);
@@ -830,19 +756,19 @@ namespace YACE
           opcode0xANNN(opcode);
           break;
         case 0xB000:  // Jump to address NNN plus V0
-          opcode0xBNNN(opcode);
+          opcode0xBNNN<Quirks>(opcode);
           break;
         case 0xC000:  // Sets VX to a random number AND NN
           opcode0xCXNN(opcode);
           break;
         case 0xD000:  // Draw sprite at screen locatn (reg VX, reg VY) height N
-          opcode0xDXYN(opcode);
+          opcode0xDXYN<Quirks>(opcode);
           break;
         case 0xE000:  // Skip next instruction if the key stored in VX is pressed
           handleOpcodes0xE000(opcode);
           break;
         case 0xF000:
-          handleOpcodes0xF000(opcode);
+          handleOpcodes0xF000<Quirks>(opcode);
           break;
         default:
           fprintf(stderr, "Unsupported opcode %X\n", opcode);
@@ -851,12 +777,334 @@ namespace YACE
     }
   }
 
+  /**
+   *  Runs translated blocks from code, falling back to the interpreter
+   *  where there is no block or when a block doesn't fit in the remaining
+   *  cycles.
+   */
+  template <typename Quirks, typename Code>
+  void CPU::execute_blocks(Code& code, int cycles)
+  {
+    int remaining = cycles;
+
+    while (remaining > 0)
+    {
+      const JIT::Block* block = code.get_block(chip8.memory, program_counter);
+
+      if (block && block->length <= remaining)
+      {
+        block->code(V, &I, &program_counter);
+        remaining -= block->length;
+
+        // Blocks only jump back with a 1NNN at their end
+        if (program_counter < block->end && !--idle_countdown)
+          remaining -= idle_cycles(block->end - 2, program_counter, remaining);
+      }
+      else
+      {
+        // A single cycle can't skip a loop, so idle is only set by a stall
+        bool skipped = idle;
+
+        idle = false;
+        interpret_end = cycles - remaining + 1;
+        interpret<Quirks>(1);
+        remaining--;
+
+        if (idle)
+          break;
+        idle = skipped;
+      }
+    }
+  }
+
+  /**
+   *  Runs blocks translated by the JIT.
+   */
+  template <typename Quirks>
+  void CPU::execute_dynarec(int cycles)
+  {
+    execute_blocks<Quirks>(jit, cycles);
+  }
+
+  /**
+   *  Runs blocks translated ahead of time by yace-recompile.
+   */
+  template <typename Quirks>
+  void CPU::execute_recompiled(int cycles)
+  {
+    execute_blocks<Quirks>(recompiled, cycles);
+  }
+
+  /**
+   *  Called every IDLE_CHECK_INTERVAL jumps back, here from address to
+   *  target with remaining cycles left after the jump. Returns how many of
+   *  them can be skipped.
+   *
+   *  Timers and keys don't change during execute(), so once a pass over
+   *  a loop that only reads and writes registers leaves them as they
+   *  were, every following pass is the same. Whole passes are then
+   *  skipped until the end of execute().
+   */
+  int CPU::idle_cycles(unsigned int address, unsigned int target, int remaining)
+  {
+    idle_countdown = IDLE_CHECK_INTERVAL;
+
+    if (!is_idle_loop(address, target))
+      return 0;
+
+    if (idle_address != address)
+    {
+      // Compare with the state at the next jump back
+      save_idle_state(idle_state);
+      idle_address = address;
+      idle_countdown = 1;
+      return 0;
+    }
+
+    IdleState current;
+    save_idle_state(current);
+    idle_address = 0;
+
+    // Only check a pass once the state has repeated
+    if (std::memcmp(&current, &idle_state, sizeof(current)))
+      return 0;
+
+    int period = loop_period(address, target);
+
+    if (!period || period > remaining)
+      return 0;
+
+    idle = true;
+    return remaining / period * period;
+  }
+
+  /**
+   *  Returns true if address holds a jump back to target, and the loop in
+   *  between is short and only contains opcodes that can't change memory
+   *  or the screen or leave the loop other than by skipping past its end.
+   */
+  bool CPU::is_idle_loop(unsigned int address, unsigned int target)
+  {
+    address &= 0xFFF;
+
+    if (idle_loops[address] == IDLE_UNKNOWN)
+    {
+      unsigned short jump = (chip8.memory[address] << 8) | chip8.memory[(address + 1) & 0xFFF];
+      bool candidate = jump == (0x1000 | target) && address < 0xFFF && address - target < MAX_IDLE_LOOP * 2;
+
+      for (unsigned int pc = target; candidate && pc < address; pc += 2)
+      {
+        switch (decode_opcode((chip8.memory[pc] << 8) | chip8.memory[pc + 1]))
+        {
+          case OP_3XNN: case OP_4XNN: case OP_5XY0: case OP_6XNN: case OP_7XNN:
+          case OP_8XY0: case OP_8XY1: case OP_8XY2: case OP_8XY3: case OP_8XY4:
+          case OP_8XY5: case OP_8XY6: case OP_8XY7: case OP_8XYE: case OP_9XY0:
+          case OP_ANNN: case OP_EX9E: case OP_EXA1: case OP_FX07: case OP_FX0A:
+          case OP_FX15: case OP_FX18: case OP_FX1E: case OP_FX29: case OP_FX30:
+          case OP_FX65:
+            break;
+          default:
+            candidate = false;
+        }
+      }
+
+      idle_loops[address] = candidate ? IDLE_CANDIDATE : IDLE_NEVER;
+    }
+
+    return idle_loops[address] == IDLE_CANDIDATE;
+  }
+
+  /**
+   *  Interprets one pass over the loop from target to the jump at address
+   *  and returns its length in cycles if it left the state unchanged, or
+   *  0 if it changed it or left the loop. The state is restored either
+   *  way.
+   */
+  int CPU::loop_period(unsigned int address, unsigned int target)
+  {
+    IdleState state;
+    save_idle_state(state);
+
+    unsigned int saved_program_counter = program_counter;
+    unsigned short saved_opcode = opcode;
+    int saved_cycles_left = cycles_left;
+    bool saved_idle = idle;
+    int cycles = 0;
+
+    probing = true;
+    program_counter = target;
+    while (program_counter >= target && program_counter < address && cycles < MAX_IDLE_LOOP)
+    {
+      interpret(1);
+      cycles++;
+    }
+
+    IdleState after;
+    save_idle_state(after);
+
+    bool unchanged = program_counter == address && !std::memcmp(&state, &after, sizeof(state));
+
+    restore_idle_state(state);
+    program_counter = saved_program_counter;
+    opcode = saved_opcode;
+    cycles_left = saved_cycles_left;
+    idle = saved_idle;
+    probing = false;
+
+    // The jump back is part of the pass
+    return unchanged ? cycles + 1 : 0;
+  }
+
+  void CPU::restore_idle_state(const IdleState& state)
+  {
+    std::memcpy(V, state.V, 16);
+    I = state.I;
+    chip8.delay_timer = state.delay_timer;
+    chip8.set_sound_timer(state.sound_timer, chip8.cycles);
+    chip8.key_is_pressed = state.key_is_pressed;
+    chip8.last_key_pressed = state.last_key_pressed;
+  }
+
+  /**
+   *  Copies the state into a zeroed IdleState so it can be compared with
+   *  memcmp.
+   */
+  void CPU::save_idle_state(IdleState& state)
+  {
+    std::memset(&state, 0, sizeof(state));
+    std::memcpy(state.V, V, 16);
+    state.I = I;
+    state.delay_timer = chip8.delay_timer;
+    state.sound_timer = chip8.sound_timer;
+    state.key_is_pressed = chip8.key_is_pressed;
+    state.last_key_pressed = chip8.last_key_pressed;
+  }
+
+  /**
+   *  Returns the bytes of sprite data at address. Sprites running past the
+   *  end of memory wrap around to its start, and are copied into buffer.
+   */
+  const unsigned char* CPU::sprite_data(unsigned int address, int bytes, unsigned char* buffer) const
+  {
+    address &= 0xFFF;
+    if (address + bytes <= 0x1000)
+      return &chip8.memory[address];
+
+    for (int i = 0; i < bytes; i++)
+      buffer[i] = chip8.memory[(address + i) & 0xFFF];
+
+    return buffer;
+  }
+
+  /**
+   *  Skips the rest of interpret() when the current opcode will repeat
+   *  without changing anything.
+   */
+  void CPU::stall()
+  {
+    cycles_left = 1;
+    idle = true;
+  }
+
+#ifdef YACE_INSTRUMENTED
+  /**
+   *  Interprets the given number of cycles, recording every instruction
+   *  in the attached trace and profile.
+   */
+  void CPU::execute_instrumented(int cycles)
+  {
+    for (int i = cycles; i > 0; i--)
+    {
+      unsigned int address = program_counter;
+
+#ifdef _TRACE_
+      char before[16];
+      if (trace)
+        std::memcpy(before, V, 16);
+#endif
+
+      interpret_end = cycles - i + 1;
+      interpret(1);
+
+#ifdef _TRACE_
+      if (trace)
+        trace->record(address, opcode, I, before, V);
+#endif
+#ifdef _PROFILE_
+      if (profile)
+        profile->record(address, opcode, program_counter, stack_size, V[0xF]);
+#endif
+    }
+  }
+#endif
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Executes the given number of cycles using the selected engine. The
+   *  interpreter is always used while tracing or profiling.
+   */
+  void CPU::execute(int cycles)
+  {
+    idle = false;
+    idle_address = 0;
+
+#ifdef YACE_INSTRUMENTED
+    if (trace || profile)
+    {
+      execute_instrumented(cycles);
+      return;
+    }
+#endif
+
+    switch (engine)
+    {
+      case THREADED:
+        (this->*engines->execute_threaded)(cycles);
+        break;
+      case DYNAREC:
+        (this->*engines->execute_dynarec)(cycles);
+        break;
+      case RECOMPILED:
+        (this->*engines->execute_recompiled)(cycles);
+        break;
+      default:
+        interpret_end = cycles;
+        interpret(cycles);
+    }
+  }
+
+  /**
+   *  Restores registers and stack from state, which Chip8 checked with
+   *  SaveState::is_valid. Translated code and decoded opcodes are dropped
+   *  since memory is replaced as well.
+   */
+  void CPU::load_state(const SaveState& state)
+  {
+    using std::memcpy;
+    using std::memset;
+
+    program_counter = state.program_counter;
+    memcpy(stack, state.stack, sizeof(stack));
+    stack_size = state.stack_size;
+    I = state.I;
+    memcpy(V, state.V, 16);
+    memcpy(RPL, state.RPL, 8);
+    random.set_state(state.random);
+
+    jit.flush();
+    recompiled.flush();
+    forget_decoded(0, 0x1000);
+    memset(idle_loops, IDLE_UNKNOWN, sizeof(idle_loops));
+  }
+
   void CPU::reset()
   {
     using std::memset;
 
     opcode = 0;
-    stack = std::stack<unsigned int>();
+    stack_size = 0;
 
     // Reset V-registers
     memset(V, 0, 16);
@@ -869,5 +1117,46 @@ namespace YACE
 
     // Reset PC-register (Program Counter)
     program_counter = 0x200;
+
+    // Drop translated code, decoded opcodes and loop analysis
+    jit.flush();
+    recompiled.flush();
+    forget_decoded(0, 0x1000);
+    memset(idle_loops, IDLE_UNKNOWN, sizeof(idle_loops));
+    idle = false;
+    idle_address = 0;
+  }
+
+  /**
+   *  Stores registers and stack in state. Opcodes are fetched with their
+   *  address wrapped around memory, so PC and the return addresses are
+   *  stored wrapped as well.
+   */
+  void CPU::save_state(SaveState& state) const
+  {
+    using std::memcpy;
+
+    state.program_counter = program_counter & 0xFFF;
+    for (int i = 0; i < 16; i++)
+      state.stack[i] = stack[i] & 0xFFF;
+    state.stack_size = stack_size;
+    state.I = I;
+    memcpy(state.V, V, 16);
+    memcpy(state.RPL, RPL, 8);
+    state.random = random.get_state();
+  }
+
+  /**
+   *  Selects the engines instantiated for a quirk profile.
+   */
+  void CPU::set_quirks(QUIRK_PROFILES quirks)
+  {
+    if (quirks < 0 || quirks >= QUIRK_PROFILE_COUNT)
+      throw "Invalid quirk profile!";
+
+    this->quirks = quirks;
+    engines = &QUIRK_ENGINES[quirks];
+    jit.set_shift_vy(engines->shift_vy);
+    recompiled.set_quirks(quirks);
   }
 }
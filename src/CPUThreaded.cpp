@@ -0,0 +1,524 @@
+#include "../include/CPU.h"
+#include "../include/Chip8.h"
+#include "../include/Opcodes.h"
+
+namespace YACE
+{
+  /**
+   *  Decodes the opcode at address, which is below 0xFFF, into its cache
+   *  entry. Common sequences starting there are fused into a
+   *  superinstruction. The fields of the opcodes after it are decoded as
+   *  well but their handlers are left alone.
+   */
+  void CPU::decode(unsigned int address)
+  {
+    const unsigned char* table = opcode_table();
+    DecodedOpcode* entry = &decoded[address];
+    unsigned char kinds[MAX_FUSED] = {};
+    int count = 0;
+
+    for (; count < MAX_FUSED && address + count * 2 < 0xFFF; count++)
+    {
+      unsigned int at = address + count * 2;
+      unsigned short opcode = (chip8.memory[at] << 8) | chip8.memory[at + 1];
+
+      entry[count * 2].opcode = opcode;
+      entry[count * 2].x = (opcode & 0x0F00) >> 8;
+      entry[count * 2].y = (opcode & 0x00F0) >> 4;
+      kinds[count] = table[opcode];
+    }
+
+    entry->handler = kinds[0];
+    if (count < 2)
+      return;
+
+    switch (kinds[0])
+    {
+      case OP_ANNN:
+        if (kinds[1] == OP_DXYN)
+          entry->handler = SUPER_ANNN_DXYN;
+        break;
+      case OP_6XNN:
+        if (kinds[1] == OP_6XNN)
+          entry->handler = SUPER_6XNN_6XNN;
+        break;
+      case OP_7XNN:
+        // Loop counters, usually closed by a jump back
+        if (kinds[1] == OP_3XNN)
+          entry->handler = count == 3 && kinds[2] == OP_1NNN ? SUPER_7XNN_3XNN_1NNN : SUPER_7XNN_3XNN;
+        else if (kinds[1] == OP_4XNN)
+          entry->handler = count == 3 && kinds[2] == OP_1NNN ? SUPER_7XNN_4XNN_1NNN : SUPER_7XNN_4XNN;
+        break;
+      case OP_FX07:
+        if (kinds[1] == OP_3XNN)
+          entry->handler = SUPER_FX07_3XNN;
+        break;
+    }
+  }
+
+  /**
+   *  Threaded interpreter.
+   *
+   *  Opcodes are dispatched with computed gotos through the decoded
+   *  opcode cache. An address is fetched and decoded the first time it
+   *  runs, and again after memory_written() covers it. PC, I and V are
+   *  kept in locals for the whole run and are only written back when
+   *  leaving the loop or calling into Chip8.
+   *
+   *  A superinstruction runs its first opcode and goes straight to the
+   *  handler of the next, so only the first is dispatched. It's only
+   *  taken when there are cycles left for all its opcodes.
+   */
+  template <typename Quirks>
+  void CPU::execute_threaded(int cycles)
+  {
+    static void* const labels[HANDLER_COUNT] =
+    {
+      &&op_0NNN, &&op_00CN, &&op_00E0, &&op_00EE, &&op_00FB, &&op_00FC, &&op_00FD, &&op_00FE, &&op_00FF,
+      &&op_1NNN, &&op_2NNN, &&op_3XNN, &&op_4XNN, &&op_5XY0, &&op_6XNN, &&op_7XNN,
+      &&op_8XY0, &&op_8XY1, &&op_8XY2, &&op_8XY3, &&op_8XY4, &&op_8XY5, &&op_8XY6, &&op_8XY7, &&op_8XYE,
+      &&op_9XY0, &&op_ANNN, &&op_BNNN, &&op_CXNN, &&op_DXYN, &&op_EX9E, &&op_EXA1,
+      &&op_FX07, &&op_FX0A, &&op_FX15, &&op_FX18, &&op_FX1E, &&op_FX29, &&op_FX30, &&op_FX33,
+      &&op_FX55, &&op_FX65, &&op_FX75, &&op_FX85,
+      &&op_UNKNOWN, &&op_fetch,
+      &&op_ANNN_DXYN, &&op_6XNN_6XNN, &&op_7XNN_3XNN, &&op_7XNN_4XNN, &&op_7XNN_3XNN_1NNN,
+      &&op_7XNN_4XNN_1NNN, &&op_FX07_3XNN
+    };
+
+    if (cycles <= 0)
+      return;
+
+    const unsigned char* table = opcode_table();
+    unsigned char* memory = chip8.memory;
+
+    unsigned int pc = program_counter;
+    short i = I;
+    char v[16];
+    std::memcpy(v, V, 16);
+
+    DecodedOpcode* cache = decoded;
+    const DecodedOpcode* op = 0;
+    DecodedOpcode uncached;     // Past the end of memory, decoded every time
+    int remaining = cycles;
+
+    #define LOAD_STATE() do { pc = program_counter; i = I; std::memcpy(v, V, 16); } while (0)
+    #define STORE_STATE() do { program_counter = pc; I = i; std::memcpy(V, v, 16); } while (0)
+    #define X (op->x)
+    #define Y (op->y)
+    #define N (op->opcode & 0x000F)
+    #define NN (op->opcode & 0x00FF)
+    #define NNN (op->opcode & 0x0FFF)
+    #define SHIFTED (Quirks::SHIFT_VY ? Y : X)
+    #define DISPATCH() \
+      do \
+      { \
+        if (pc > 0xFFE) \
+          goto op_fetch; \
+        op = &cache[pc]; \
+        goto *labels[op->handler]; \
+      } while (0)
+    #define NEXT() \
+      do \
+      { \
+        if (--remaining > 0) \
+          DISPATCH(); \
+        goto done; \
+      } while (0)
+    #define FUSED(count) \
+      do \
+      { \
+        if (remaining < count) \
+          goto *labels[table[op->opcode]]; \
+      } while (0)
+    #define STEP() \
+      do \
+      { \
+        pc += 2; \
+        op += 2; \
+        remaining--; \
+      } while (0)
+
+    DISPATCH();
+
+    op_fetch:
+      if (pc > 0xFFE)
+      {
+        unsigned short fetched = (memory[pc & 0xFFF] << 8) | memory[(pc + 1) & 0xFFF];
+
+        uncached.opcode = fetched;
+        uncached.handler = table[fetched];
+        uncached.x = (fetched & 0x0F00) >> 8;
+        uncached.y = (fetched & 0x00F0) >> 4;
+        op = &uncached;
+      }
+      else
+      {
+        decode(pc);
+        op = &cache[pc];
+      }
+      goto *labels[op->handler];
+
+    op_ANNN_DXYN:
+      FUSED(2);
+      i = NNN;
+      STEP();
+      goto op_DXYN;
+
+    op_6XNN_6XNN:
+      FUSED(2);
+      v[X] = NN;
+      STEP();
+      goto op_6XNN;
+
+    op_7XNN_3XNN:
+      FUSED(2);
+      v[X] += NN;
+      STEP();
+      goto op_3XNN;
+
+    op_7XNN_4XNN:
+      FUSED(2);
+      v[X] += NN;
+      STEP();
+      goto op_4XNN;
+
+    op_7XNN_3XNN_1NNN:
+      FUSED(3);
+      v[X] += NN;
+      STEP();
+      if ((v[X] & 0xFF) == NN)
+      {
+        pc += 4;
+        NEXT();
+      }
+      STEP();
+      goto op_1NNN;
+
+    op_7XNN_4XNN_1NNN:
+      FUSED(3);
+      v[X] += NN;
+      STEP();
+      if ((v[X] & 0xFF) != NN)
+      {
+        pc += 4;
+        NEXT();
+      }
+      STEP();
+      goto op_1NNN;
+
+    op_FX07_3XNN:
+      FUSED(2);
+      v[X] = chip8.delay_timer;
+      STEP();
+      goto op_3XNN;
+
+    op_0NNN:
+      // Repeats until the next call
+      idle = true;
+      goto done;
+
+    op_00CN:
+      chip8.video.scroll_down(N);
+      pc += 2;
+      NEXT();
+
+    op_00E0:
+      chip8.video.clear();
+      pc += 2;
+      NEXT();
+
+    op_00EE:
+      if (stack_size > 0)
+        pc = stack[--stack_size] + 2;
+      else
+        pc += 2;
+      NEXT();
+
+    op_00FB:
+      chip8.video.scroll_right();
+      pc += 2;
+      NEXT();
+
+    op_00FC:
+      chip8.video.scroll_left();
+      pc += 2;
+      NEXT();
+
+    op_00FD:
+      STORE_STATE();
+      chip8.reset();
+      LOAD_STATE();
+      pc += 2;
+      NEXT();
+
+    op_00FE:
+      chip8.video.set_mode(Framebuffer::CHIP8);
+      pc += 2;
+      NEXT();
+
+    op_00FF:
+      chip8.video.set_mode(Framebuffer::SUPERCHIP);
+      pc += 2;
+      NEXT();
+
+    op_1NNN:
+      if (NNN <= pc && !--idle_countdown)
+      {
+        STORE_STATE();
+        remaining -= idle_cycles(pc, NNN, remaining - 1);
+      }
+      pc = NNN;
+      NEXT();
+
+    op_2NNN:
+      if (stack_size < 16)
+      {
+        stack[stack_size++] = pc;
+        pc = NNN;
+      }
+      else
+        pc += 2;
+      NEXT();
+
+    op_3XNN:
+      pc += ((v[X] & 0xFF) == NN) ? 4 : 2;
+      NEXT();
+
+    op_4XNN:
+      pc += ((v[X] & 0xFF) != NN) ? 4 : 2;
+      NEXT();
+
+    op_5XY0:
+      pc += ((v[X] & 0xFF) == (v[Y] & 0xFF)) ? 4 : 2;
+      NEXT();
+
+    op_6XNN:
+      v[X] = NN;
+      pc += 2;
+      NEXT();
+
+    op_7XNN:
+      v[X] += NN;
+      pc += 2;
+      NEXT();
+
+    op_8XY0:
+      v[X] = v[Y] & 0xFF;
+      pc += 2;
+      NEXT();
+
+    op_8XY1:
+      v[X] |= (v[Y] & 0xFF);
+      pc += 2;
+      NEXT();
+
+    op_8XY2:
+      v[X] &= v[Y];
+      pc += 2;
+      NEXT();
+
+    op_8XY3:
+      v[X] ^= v[Y];
+      pc += 2;
+      NEXT();
+
+    op_8XY4:
+      v[0xF] = ((v[X] & 0xFF) + (v[Y] & 0xFF)) > 0xFF;
+      v[X] += v[Y] & 0xFF;
+      pc += 2;
+      NEXT();
+
+    op_8XY5:
+      v[0xF] = !((v[X] & 0xFF) < (v[Y] & 0xFF));
+      v[X] -= v[Y] & 0xFF;
+      pc += 2;
+      NEXT();
+
+    op_8XY6:
+      v[0xF] = v[SHIFTED] & 1;
+      v[X] = (v[SHIFTED] & 0xFF) >> 1;
+      pc += 2;
+      NEXT();
+
+    op_8XY7:
+      v[0xF] = !(v[Y] < v[X]);
+      v[X] = (v[Y] & 0xFF) - (v[X] & 0xFF);
+      pc += 2;
+      NEXT();
+
+    op_8XYE:
+      v[0xF] = (v[SHIFTED] & 0xFF) >> 7;
+      v[X] = (v[SHIFTED] & 0xFF) << 1;
+      pc += 2;
+      NEXT();
+
+    op_9XY0:
+      pc += ((v[X] & 0xFF) != (v[Y] & 0xFF)) ? 4 : 2;
+      NEXT();
+
+    op_ANNN:
+      i = NNN;
+      pc += 2;
+      NEXT();
+
+    op_BNNN:
+      pc = v[Quirks::JUMP_VX ? X : 0] + NNN;
+      NEXT();
+
+    op_CXNN:
+      v[X] = random.next_byte() & NN;
+      pc += 2;
+      NEXT();
+
+    op_DXYN:
+      {
+        v[0xF] = 0;
+
+        int lines = N;
+        int width = 8;
+
+        if (lines == 0)
+        {
+          lines = 16;
+          width = 8 << chip8.video.get_mode();
+        }
+
+        unsigned char buffer[32];
+        const unsigned char* sprite = sprite_data(i, lines * width / 8, buffer);
+
+        if (Quirks::WRAP_SPRITES)
+          v[0xF] = chip8.video.draw_wrapped_sprite(v[X] & 0xFF, v[Y] & 0xFF, sprite, lines, width);
+        else
+          v[0xF] = chip8.video.draw_sprite(v[X] & 0xFF, v[Y] & 0xFF, sprite, lines, width);
+      }
+      pc += 2;
+      NEXT();
+
+    op_EX9E:
+      if (chip8.keys[int(v[X])])
+        pc += 2;
+      pc += 2;
+      NEXT();
+
+    op_EXA1:
+      if (!chip8.keys[int(v[X])])
+        pc += 2;
+      pc += 2;
+      NEXT();
+
+    op_FX07:
+      v[X] = chip8.delay_timer;
+      pc += 2;
+      NEXT();
+
+    op_FX0A:
+      if (chip8.key_is_pressed)
+      {
+        v[X] = chip8.last_key_pressed;
+        chip8.key_is_pressed = false;
+        pc += 2;
+        NEXT();
+      }
+      // Keys only change between calls to execute()
+      idle = true;
+      goto done;
+
+    op_FX15:
+      chip8.delay_timer = v[X];
+      pc += 2;
+      NEXT();
+
+    op_FX18:
+      chip8.set_sound_timer(v[X], chip8.cycles + cycles - remaining);
+      pc += 2;
+      NEXT();
+
+    op_FX1E:
+      i += v[X];
+      if (Quirks::ADD_I_OVERFLOW)
+        v[0xF] = i > 0xFFF;
+      pc += 2;
+      NEXT();
+
+    op_FX29:
+      i = chip8.FONT_CHIP8 + (v[X] * 5);
+      pc += 2;
+      NEXT();
+
+    op_FX30:
+      i = chip8.FONT_SUPERCHIP + (v[X] * 10);
+      pc += 2;
+      NEXT();
+
+    op_FX33:
+      memory[i & 0xFFF] = v[X] / 100;
+      memory[(i + 1) & 0xFFF] = (v[X] / 10) % 10;
+      memory[(i + 2) & 0xFFF] = v[X] % 10;
+      memory_written(i & 0xFFF, 3);
+      pc += 2;
+      NEXT();
+
+    op_FX55:
+      {
+        int last = X;
+
+        for (int r = 0; r <= last; r++)
+          memory[(i + r) & 0xFFF] = v[r];
+        memory_written(i & 0xFFF, last + 1);
+        if (Quirks::INCREMENT_I)
+          i += last + 1;
+      }
+      pc += 2;
+      NEXT();
+
+    op_FX65:
+      for (int r = 0; r <= X; r++)
+        v[r] = memory[(i + r) & 0xFFF];
+      if (Quirks::INCREMENT_I)
+        i += X + 1;
+      pc += 2;
+      NEXT();
+
+    op_FX75:
+      {
+        int last = X;
+
+        for (int r = 0; r <= last; r++)
+          RPL[r] = v[r];
+      }
+      pc += 2;
+      NEXT();
+
+    op_FX85:
+      for (int r = 0; r <= X; r++)
+        v[r] = RPL[r];
+      pc += 2;
+      NEXT();
+
+    op_UNKNOWN:
+      pc += 2;
+      NEXT();
+
+    done:
+      opcode = op->opcode;
+      STORE_STATE();
+
+    #undef STEP
+    #undef FUSED
+    #undef NEXT
+    #undef DISPATCH
+    #undef SHIFTED
+    #undef NNN
+    #undef NN
+    #undef N
+    #undef Y
+    #undef X
+    #undef STORE_STATE
+    #undef LOAD_STATE
+  }
+
+  template void CPU::execute_threaded<DefaultQuirks>(int cycles);
+  template void CPU::execute_threaded<Chip8Quirks>(int cycles);
+  template void CPU::execute_threaded<SuperChipQuirks>(int cycles);
+  template void CPU::execute_threaded<ModernQuirks>(int cycles);
+}
@@ -1,74 +1,251 @@
+#if defined(__unix__)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include <climits>
+
 #include "../include/Chip8.h"
+#include "../include/Fonts.h"
+#include "../include/Movie.h"
 
 namespace YACE
 {
-  Chip8::Chip8() : FONT_CHIP8(0x109), FONT_SUPERCHIP(0x159), cpu(CPU(*this)), cpu_cycles(400), delay_timer(0), sound_timer(0), key_is_pressed(false), last_key_pressed(KEY_0)
+  Chip8::Chip8() : FONT_CHIP8(0x109), FONT_SUPERCHIP(0x159), cpu(*this), pixels_revision(0), delay_timer(0), sound_timer(0), sound_event_count(0), cpu_frequency(400 * 60), timer_frequency(60), cycles(0), timer_base(0), timer_ticks(0), key_is_pressed(false), last_key_pressed(KEY_0), rom_hash(RomCache::hash(0, 0)), seed(Random::DEFAULT_SEED), movie(0)
   {
     reset();
     setup_fonts();
+    restart_timer_period();
   }
 
   /*
    *  Private methods
    */
 
+  /**
+   *  Sets key state of given key
+   */
+  void Chip8::press_key(EMU_KEYS key, bool pressed)
+  {
+    keys[key - 1] = pressed;
+
+    if (pressed)
+    {
+      key_is_pressed = true;
+      last_key_pressed = key - 1;
+    }
+  }
+
   /**
    *  Resets video.
    */
   void Chip8::reset_video()
   {
-    video_mode = CHIP8;
-    std::memset(video, 0, 0x2000);
+    video.set_mode(Framebuffer::CHIP8);
+    video.clear();
   }
 
   /**
-   *  Setup fonts
+   *  Starts a new timer period at the current cycle. Between steps this
+   *  is also where the last tick happened.
    */
-  void Chip8::setup_fonts()
+  void Chip8::restart_timer_period()
   {
-    // Setup Chip8-font (5-byte font)
-    read_font("chip8.font", memory + FONT_CHIP8, 0x50);
+    timer_base = cycles;
+    timer_ticks = 0;
+    schedule_tick();
+  }
+
+  /**
+   *  Restores the whole emulator from a state saved by save_state, which
+   *  isn't checked again.
+   */
+  void Chip8::restore_state(const SaveState& state)
+  {
+    std::memcpy(memory, state.memory, sizeof(memory));
+    cpu.load_state(state);
+
+    Framebuffer::Row rows[64];
+    for (int y = 0; y < 64; y++)
+      rows[y] = (Framebuffer::Row(state.video[y][0]) << 64) | state.video[y][1];
+    video.load(rows, state.video_mode ? Framebuffer::SUPERCHIP : Framebuffer::CHIP8);
+
+    delay_timer = state.delay_timer;
+    set_sound_timer(state.sound_timer, cycles);
+
+    for (int key = 0; key < 16; key++)
+      keys[key] = state.keys[key];
+    key_is_pressed = state.key_is_pressed;
+    last_key_pressed = state.last_key_pressed;
+
+    restart_timer_period();
+  }
+
+  void Chip8::schedule_tick()
+  {
+    next_tick = timer_base + ((unsigned long long)(timer_ticks + 1) * cpu_frequency + timer_frequency - 1) / timer_frequency;
+  }
+
+  /**
+   *  Sets the sound timer at the given cycle, recording an event if the
+   *  sound starts or stops.
+   */
+  void Chip8::set_sound_timer(unsigned int value, unsigned long long cycle)
+  {
+    if ((value > 0) != (sound_timer > 0))
+    {
+      SoundEvent event = {cycle, value > 0};
+      sound_events[sound_event_count++ % SOUND_EVENTS] = event;
+    }
 
-    // Setup SuperChip-font (10-byte font)
-    read_font("superchip.font", memory + FONT_SUPERCHIP, 0xA0);
+    sound_timer = value;
   }
 
   /**
-   *  Reads a font file.
+   *  Decrements the timers and schedules the next tick, which is the one
+   *  due now.
    */
-  void Chip8::read_font(const char* file, unsigned char* destination, int size)
+  void Chip8::tick_timers()
   {
-    // Open font file
-    FILE* font = fopen(file, "rb");
+    if (delay_timer > 0)
+      delay_timer--;
 
-    if (font)
+    if (sound_timer > 0)
+      set_sound_timer(sound_timer - 1, next_tick);
+
+    // A second of ticks is a whole number of cycles
+    if (++timer_ticks == timer_frequency)
     {
-      // Read font to destination
-      fread(destination, 1, size, font);
-      fclose(font);
+      timer_base += cpu_frequency;
+      timer_ticks = 0;
     }
+
+    schedule_tick();
+  }
+
+  /**
+   *  Copies the built-in fonts into memory.
+   */
+  void Chip8::setup_fonts()
+  {
+    std::memcpy(memory + FONT_CHIP8, CHIP8_FONT, sizeof(CHIP8_FONT));
+    std::memcpy(memory + FONT_SUPERCHIP, SUPERCHIP_FONT, sizeof(SUPERCHIP_FONT));
   }
 
   /*
    * Public methods
    */
   /**
-   *  Loads a game into memory.
+   *  Returns the screen as one byte per pixel, with a row pitch of 64 in
+   *  Chip-8 mode and 128 in SuperChip mode.
+   */
+  const char* Chip8::get_video()
+  {
+    if (pixels_revision != video.get_revision())
+    {
+      video.expand(pixels);
+      pixels_revision = video.get_revision();
+    }
+
+    return pixels;
+  }
+
+  /**
+   *  Loads a game into memory. The file is only read the first time it is
+   *  loaded by any instance, see RomCache.
    */
   void Chip8::load_game(const char* file)
   {
-    FILE* input = fopen(file, "rb");
-    if (input)
+    load_game(*RomCache::load(file));
+  }
+
+  /**
+   *  Loads a game already in memory. Bytes that don't fit after 0x200 are
+   *  ignored.
+   */
+  void Chip8::load_game(const unsigned char* game, int length)
+  {
+    if (length > 0xE00)
+      length = 0xE00;
+
+    std::memcpy(&memory[0x200], game, length);
+    cpu.memory_written(0x200, length);
+    rom_hash = RomCache::hash(game, length);
+  }
+
+  /**
+   *  Loads a cached game without hashing it again.
+   */
+  void Chip8::load_game(const Rom& rom)
+  {
+    std::memcpy(&memory[0x200], rom.data, rom.length);
+    cpu.memory_written(0x200, rom.length);
+    rom_hash = rom.hash;
+  }
+
+  /**
+   *  Restores the whole emulator from state. Nothing changes if state is
+   *  rejected.
+   */
+  void Chip8::load_state(const SaveState& state)
+  {
+    if (!state.is_valid())
+      throw "Invalid save state!";
+
+    restore_state(state);
+  }
+
+  /**
+   *  Restores the emulator from a file written by save_state. The file is
+   *  mapped and used in place.
+   */
+  void Chip8::load_state(const char* file)
+  {
+#if defined(__unix__)
+    int input = open(file, O_RDONLY);
+    if (input < 0)
+      throw "Couldn't open specified file!";
+
+    struct stat info;
+    if (fstat(input, &info) != 0 || info.st_size != sizeof(SaveState))
     {
-      fseek(input, 0, SEEK_END);
-      int length = ftell(input);
-      fseek(input, 0, SEEK_SET);
+      close(input);
+      throw "Invalid save state!";
+    }
+
+    void* data = mmap(0, sizeof(SaveState), PROT_READ, MAP_PRIVATE, input, 0);
+    close(input);
+
+    if (data == MAP_FAILED)
+      throw "Couldn't read specified file!";
 
-      fread(&memory[0x200], 1, length, input);
-      fclose(input);
+    try
+    {
+      load_state(*(const SaveState*)data);
     }
-    else
+    catch (...)
+    {
+      munmap(data, sizeof(SaveState));
+      throw;
+    }
+
+    munmap(data, sizeof(SaveState));
+#else
+    FILE* input = fopen(file, "rb");
+    if (!input)
       throw "Couldn't open specified file!";
+
+    SaveState state;
+    bool complete = fread(&state, sizeof(SaveState), 1, input) == 1;
+    fclose(input);
+
+    if (!complete)
+      throw "Invalid save state!";
+
+    load_state(state);
+#endif
   }
 
   /**
@@ -94,30 +271,128 @@ namespace YACE
   }
 
   /**
-   *  Sets key state of given key
+   *  Runs the CPU until the cycle count reaches deadline, ticking the
+   *  timers at every tick due on the way, including one due at deadline.
+   *  Input played back by a Movie is applied at its cycle, after the ticks.
    */
-  void Chip8::set_key(EMU_KEYS key, bool pressed)
+  void Chip8::run_until(unsigned long long deadline)
   {
-    keys[key - 1] = pressed;
+    for (;;)
+    {
+      while (next_tick <= cycles)
+        tick_timers();
 
-    if (pressed)
+      unsigned long long input = movie ? movie->play_input() : ULLONG_MAX;
+
+      if (cycles >= deadline)
+        break;
+
+      unsigned long long end = next_tick < deadline ? next_tick : deadline;
+      if (input < end)
+        end = input;
+      if (end - cycles > INT_MAX)
+        end = cycles + INT_MAX;
+
+      cpu.execute(end - cycles);
+      cycles = end;
+    }
+  }
+
+  /**
+   *  Stores the whole emulator in state.
+   */
+  void Chip8::save_state(SaveState& state) const
+  {
+    std::memset(&state, 0, sizeof(SaveState));
+    state.magic = SaveState::MAGIC;
+    state.version = SaveState::VERSION;
+    state.size = sizeof(SaveState);
+
+    cpu.save_state(state);
+
+    const Framebuffer::Row* rows = video.get_rows();
+    for (int y = 0; y < 64; y++)
     {
-      key_is_pressed = true;
-      last_key_pressed = key - 1;
+      state.video[y][0] = rows[y] >> 64;
+      state.video[y][1] = rows[y];
     }
+    state.video_mode = video.get_mode();
+
+    state.delay_timer = delay_timer;
+    state.sound_timer = sound_timer;
+
+    for (int key = 0; key < 16; key++)
+      state.keys[key] = keys[key];
+    state.key_is_pressed = key_is_pressed;
+    state.last_key_pressed = last_key_pressed;
+
+    std::memcpy(state.memory, memory, sizeof(memory));
   }
 
   /**
-   * Steps the emulator.
+   *  Writes the whole emulator to a file with a single write.
    */
-  void Chip8::step()
+  void Chip8::save_state(const char* file) const
   {
-    cpu.execute(cpu_cycles);
+    SaveState state;
+    save_state(state);
 
-    if (delay_timer > 0)
-      delay_timer--;
+    FILE* output = fopen(file, "wb");
+    bool written = output && fwrite(&state, sizeof(SaveState), 1, output) == 1;
 
-    if (sound_timer > 0)
-      sound_timer--;
+    if (output && fclose(output) != 0)
+      written = false;
+
+    if (!written)
+      throw "Couldn't write specified file!";
+  }
+
+  /**
+   *  Sets the CPU clock in cycles per second.
+   */
+  void Chip8::set_cpu_frequency(unsigned int frequency)
+  {
+    if (frequency == 0)
+      throw "Invalid frequency!";
+
+    cpu_frequency = frequency;
+    restart_timer_period();
+  }
+
+  /**
+   *  Sets key state of given key. While a Movie is played back the keys
+   *  come from it and this does nothing.
+   */
+  void Chip8::set_key(EMU_KEYS key, bool pressed)
+  {
+    if (movie && !movie->record_key(cycles, key, pressed))
+      return;
+
+    press_key(key, pressed);
+  }
+
+  /**
+   *  Sets the rate the delay and sound timers count down at, in ticks per
+   *  second. step() runs the CPU for one tick.
+   */
+  void Chip8::set_timer_frequency(unsigned int frequency)
+  {
+    if (frequency == 0)
+      throw "Invalid frequency!";
+
+    timer_frequency = frequency;
+    restart_timer_period();
+  }
+
+  /**
+   *  Returns a hash of the whole emulator as stored by save_state, to
+   *  compare runs that should be identical.
+   */
+  unsigned long long Chip8::state_hash() const
+  {
+    SaveState state;
+    save_state(state);
+
+    return RomCache::hash((const unsigned char*)&state, sizeof(SaveState));
   }
 }
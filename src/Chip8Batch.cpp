@@ -0,0 +1,824 @@
+#include <cstdlib>
+#include <cstring>
+
+#include "../include/Chip8Batch.h"
+#include "../include/Fonts.h"
+#include "../include/Opcodes.h"
+
+// The vector helpers are always inlined, so no 32-byte vector is ever
+// returned between code using the two calling conventions GCC warns about
+#pragma GCC diagnostic ignored "-Wpsabi"
+
+namespace YACE
+{
+  namespace
+  {
+    /**
+     *  Width lanes in one register, 16 for SSE2 and 32 for AVX2. GCC
+     *  lowers the operators to the instructions of the function's target,
+     *  or to scalar code on hosts without vectors.
+     */
+    template <int Width>
+    struct Vector
+    {
+      typedef unsigned char Bytes __attribute__((vector_size(Width)));
+      typedef signed char SignedBytes __attribute__((vector_size(Width)));
+    };
+
+    const int MAX_VECTOR_WIDTH = 32;
+
+    template <typename Bytes>
+    inline __attribute__((always_inline)) Bytes load(const void* source)
+    {
+      Bytes value;
+      std::memcpy(&value, source, sizeof(value));
+      return value;
+    }
+
+    template <typename Bytes>
+    inline __attribute__((always_inline)) void store(void* destination, const Bytes& value)
+    {
+      std::memcpy(destination, &value, sizeof(value));
+    }
+
+    /**
+     *  Stores value in the lanes selected by mask.
+     */
+    template <typename Bytes>
+    inline __attribute__((always_inline)) void store_masked(void* destination, const Bytes& value, const Bytes& mask)
+    {
+      store(destination, (value & mask) | (load<Bytes>(destination) & ~mask));
+    }
+
+    template <typename T>
+    T* allocate(int count)
+    {
+      T* data = new T[count];
+      std::memset(data, 0, sizeof(T) * count);
+      return data;
+    }
+  }
+
+  Chip8Batch::Chip8Batch(int instances) : instances(instances), cpu_cycles(400)
+  {
+    lanes = (instances + MAX_VECTOR_WIDTH - 1) / MAX_VECTOR_WIDTH * MAX_VECTOR_WIDTH;
+
+    memory = allocate<unsigned char>(0x1000 * lanes);
+    V = allocate<char>(16 * lanes);
+    RPL = allocate<char>(8 * lanes);
+    stack = allocate<unsigned int>(16 * lanes);
+    keys = allocate<bool>(16 * lanes);
+
+    program_counter = allocate<unsigned int>(lanes);
+    I = allocate<short>(lanes);
+    stack_size = allocate<unsigned char>(lanes);
+    delay_timer = allocate<unsigned int>(lanes);
+    sound_timer = allocate<unsigned int>(lanes);
+    key_is_pressed = allocate<bool>(lanes);
+    last_key_pressed = allocate<unsigned char>(lanes);
+    random = new Random[lanes];
+    video = new Framebuffer[lanes];
+
+    active = allocate<unsigned char>(lanes);
+    pending = allocate<unsigned char>(lanes);
+    group = allocate<unsigned char>(lanes);
+    skip = allocate<unsigned char>(lanes);
+
+    // Padding lanes never execute
+    std::memset(active, 0xFF, instances);
+
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    avx2 = __builtin_cpu_supports("avx2");
+#endif
+
+    for (int lane = 0; lane < lanes; lane++)
+      last_key_pressed[lane] = Chip8::KEY_0;
+
+    reset();
+
+    // Fonts are copied into every lane
+    for (int address = 0; address < (int)sizeof(CHIP8_FONT); address++)
+      std::memset(memory + (FONT_CHIP8 + address) * lanes, CHIP8_FONT[address], lanes);
+    for (int address = 0; address < (int)sizeof(SUPERCHIP_FONT); address++)
+      std::memset(memory + (FONT_SUPERCHIP + address) * lanes, SUPERCHIP_FONT[address], lanes);
+  }
+
+  Chip8Batch::~Chip8Batch()
+  {
+    delete[] memory;
+    delete[] V;
+    delete[] RPL;
+    delete[] stack;
+    delete[] keys;
+    delete[] program_counter;
+    delete[] I;
+    delete[] stack_size;
+    delete[] delay_timer;
+    delete[] sound_timer;
+    delete[] key_is_pressed;
+    delete[] last_key_pressed;
+    delete[] random;
+    delete[] video;
+    delete[] active;
+    delete[] pending;
+    delete[] group;
+    delete[] skip;
+  }
+
+  /*
+   *  Private methods
+   */
+  /**
+   *  Executes cycles on every lane.
+   *
+   *  While all instances share the same PC the whole batch is executed as
+   *  one group with a single program counter. Once they diverge, the lanes
+   *  are split into groups sharing PC and opcode every cycle and each group
+   *  is executed together, until they meet again.
+   */
+  template <int Width>
+  inline __attribute__((always_inline)) void Chip8Batch::execute(int cycles)
+  {
+    typedef typename Vector<Width>::Bytes Bytes;
+
+    for (int cycle = 0; cycle < cycles; cycle++)
+    {
+      if (converged)
+      {
+        unsigned int pc = common_program_counter;
+
+        if (pc <= 0xFFE && (!memory_diverged || same_opcode<Width>(pc)))
+        {
+          unsigned short opcode = (memory[pc * lanes] << 8) | memory[(pc + 1) * lanes];
+          std::memcpy(group, active, lanes);
+
+          if (decode_opcode(opcode) == OP_1NNN)
+            common_program_counter = opcode & 0x0FFF;
+          else if (execute_vector<Width>(opcode))
+            common_program_counter += 2;
+          else if (find_skips<Width>(opcode))
+          {
+            Bytes any = Bytes{};
+            Bytes all = ~Bytes{};
+
+            for (int lane = 0; lane < lanes; lane += Width)
+            {
+              any |= load<Bytes>(skip + lane);
+              all &= load<Bytes>(skip + lane) | ~load<Bytes>(active + lane);
+            }
+
+            bool some_skip = false;
+            bool all_skip = true;
+            for (int i = 0; i < Width; i++)
+            {
+              some_skip |= any[i] != 0;
+              all_skip &= all[i] != 0;
+            }
+
+            if (all_skip)
+              common_program_counter += 4;
+            else if (!some_skip)
+              common_program_counter += 2;
+            else
+            {
+              // The batch splits in two
+              spread_program_counter();
+              for (int lane = 0; lane < lanes; lane++)
+                program_counter[lane] += group[lane] & (2 + (skip[lane] & 2));
+
+              converged = false;
+            }
+          }
+          else
+          {
+            spread_program_counter();
+            for (int lane = 0; lane < instances; lane++)
+              execute_lane(lane);
+
+            converged = same_program_counter();
+          }
+
+          continue;
+        }
+
+        spread_program_counter();
+        converged = false;
+      }
+
+      std::memcpy(pending, active, lanes);
+      int left = instances;
+      int first = 0;
+
+      while (left > 0)
+      {
+        while (!pending[first])
+          first++;
+
+        unsigned int pc = program_counter[first];
+
+        if (pc > 0xFFE)
+        {
+          execute_lane(first);
+          pending[first] = 0;
+          left--;
+          continue;
+        }
+
+        const unsigned char* high = memory + pc * lanes;
+        const unsigned char* low = high + lanes;
+        unsigned short opcode = (high[first] << 8) | low[first];
+        int count = 0;
+
+        std::memset(group, 0, first);
+        for (int lane = first; lane < lanes; lane++)
+        {
+          bool member = pending[lane] && program_counter[lane] == pc &&
+                        high[lane] == high[first] && low[lane] == low[first];
+
+          group[lane] = member ? 0xFF : 0;
+          count += member;
+        }
+
+        if (count > 1 && decode_opcode(opcode) == OP_1NNN)
+        {
+          for (int lane = first; lane < lanes; lane++)
+            program_counter[lane] = group[lane] ? opcode & 0x0FFF : program_counter[lane];
+        }
+        else if (count > 1 && execute_vector<Width>(opcode))
+        {
+          for (int lane = first; lane < lanes; lane++)
+            program_counter[lane] += group[lane] & 2;
+        }
+        else if (count > 1 && find_skips<Width>(opcode))
+        {
+          for (int lane = first; lane < lanes; lane++)
+            program_counter[lane] += group[lane] & (2 + (skip[lane] & 2));
+        }
+        else
+        {
+          for (int lane = first; lane < lanes; lane++)
+          {
+            if (group[lane])
+              execute_lane(lane);
+          }
+        }
+
+        for (int lane = first; lane < lanes; lane++)
+          pending[lane] &= ~group[lane];
+
+        left -= count;
+      }
+
+      converged = same_program_counter();
+    }
+  }
+
+#if defined(__x86_64__)
+  /**
+   *  Executes cycles 32 lanes at a time, with AVX2 instructions.
+   */
+  __attribute__((target("avx2")))
+  void Chip8Batch::execute_avx2(int cycles)
+  {
+    execute<32>(cycles);
+  }
+#endif
+
+  /**
+   *  Executes a register opcode on all lanes in the current group with
+   *  vector operations. Returns false for any other opcode.
+   */
+  template <int Width>
+  inline __attribute__((always_inline)) bool Chip8Batch::execute_vector(unsigned short opcode)
+  {
+    typedef typename Vector<Width>::Bytes Bytes;
+    typedef typename Vector<Width>::SignedBytes SignedBytes;
+
+    int x = (opcode & 0x0F00) >> 8;
+    int y = (opcode & 0x00F0) >> 4;
+    unsigned char nn = opcode & 0x00FF;
+    unsigned int nnn = opcode & 0x0FFF;
+
+    char* vx = V + x * lanes;
+    char* vy = V + y * lanes;
+    char* vf = V + 0xF * lanes;
+
+    switch (decode_opcode(opcode))
+    {
+      case OP_6XNN:
+        for (int lane = 0; lane < lanes; lane += Width)
+          store_masked(vx + lane, Bytes{} + nn, load<Bytes>(group + lane));
+        break;
+      case OP_7XNN:
+        for (int lane = 0; lane < lanes; lane += Width)
+          store_masked(vx + lane, load<Bytes>(vx + lane) + nn, load<Bytes>(group + lane));
+        break;
+      case OP_8XY0:
+        for (int lane = 0; lane < lanes; lane += Width)
+          store_masked(vx + lane, load<Bytes>(vy + lane), load<Bytes>(group + lane));
+        break;
+      case OP_8XY1:
+        for (int lane = 0; lane < lanes; lane += Width)
+          store_masked(vx + lane, load<Bytes>(vx + lane) | load<Bytes>(vy + lane), load<Bytes>(group + lane));
+        break;
+      case OP_8XY2:
+        for (int lane = 0; lane < lanes; lane += Width)
+          store_masked(vx + lane, load<Bytes>(vx + lane) & load<Bytes>(vy + lane), load<Bytes>(group + lane));
+        break;
+      case OP_8XY3:
+        for (int lane = 0; lane < lanes; lane += Width)
+          store_masked(vx + lane, load<Bytes>(vx + lane) ^ load<Bytes>(vy + lane), load<Bytes>(group + lane));
+        break;
+      case OP_8XY4:   // VF = carry, then VX += VY
+        for (int lane = 0; lane < lanes; lane += Width)
+        {
+          Bytes mask = load<Bytes>(group + lane);
+          Bytes carry = (Bytes)(load<Bytes>(vx + lane) > ~load<Bytes>(vy + lane));
+          store_masked(vf + lane, carry & 1, mask);
+          store_masked(vx + lane, load<Bytes>(vx + lane) + load<Bytes>(vy + lane), mask);
+        }
+        break;
+      case OP_8XY5:   // VF = !borrow, then VX -= VY
+        for (int lane = 0; lane < lanes; lane += Width)
+        {
+          Bytes mask = load<Bytes>(group + lane);
+          Bytes no_borrow = (Bytes)(load<Bytes>(vx + lane) >= load<Bytes>(vy + lane));
+          store_masked(vf + lane, no_borrow & 1, mask);
+          store_masked(vx + lane, load<Bytes>(vx + lane) - load<Bytes>(vy + lane), mask);
+        }
+        break;
+      case OP_8XY6:   // VF = VX & 1, then VX >>= 1
+        for (int lane = 0; lane < lanes; lane += Width)
+        {
+          Bytes mask = load<Bytes>(group + lane);
+          store_masked(vf + lane, load<Bytes>(vx + lane) & 1, mask);
+          store_masked(vx + lane, load<Bytes>(vx + lane) >> 1, mask);
+        }
+        break;
+      case OP_8XY7:   // VF = !(VY < VX) as signed values, then VX = VY - VX
+        for (int lane = 0; lane < lanes; lane += Width)
+        {
+          Bytes mask = load<Bytes>(group + lane);
+          SignedBytes less = (SignedBytes)load<Bytes>(vy + lane) < (SignedBytes)load<Bytes>(vx + lane);
+          store_masked(vf + lane, ~(Bytes)less & 1, mask);
+          store_masked(vx + lane, load<Bytes>(vy + lane) - load<Bytes>(vx + lane), mask);
+        }
+        break;
+      case OP_8XYE:   // VF = VX >> 7, then VX <<= 1
+        for (int lane = 0; lane < lanes; lane += Width)
+        {
+          Bytes mask = load<Bytes>(group + lane);
+          store_masked(vf + lane, load<Bytes>(vx + lane) >> 7, mask);
+          store_masked(vx + lane, load<Bytes>(vx + lane) << 1, mask);
+        }
+        break;
+      case OP_ANNN:
+        for (int lane = 0; lane < lanes; lane++)
+          I[lane] = group[lane] ? nnn : I[lane];
+        break;
+      default:
+        return false;
+    }
+
+    return true;
+  }
+
+  /**
+   *  Marks the lanes in the current group that skip the next opcode.
+   *  Returns false if opcode isn't a skip.
+   */
+  template <int Width>
+  inline __attribute__((always_inline)) bool Chip8Batch::find_skips(unsigned short opcode)
+  {
+    typedef typename Vector<Width>::Bytes Bytes;
+
+    char* vx = V + ((opcode & 0x0F00) >> 8) * lanes;
+    char* vy = V + ((opcode & 0x00F0) >> 4) * lanes;
+    unsigned char nn = opcode & 0x00FF;
+
+    for (int lane = 0; lane < lanes; lane += Width)
+    {
+      Bytes taken;
+
+      switch (decode_opcode(opcode))
+      {
+        case OP_3XNN:
+          taken = (Bytes)(load<Bytes>(vx + lane) == nn);
+          break;
+        case OP_4XNN:
+          taken = (Bytes)(load<Bytes>(vx + lane) != nn);
+          break;
+        case OP_5XY0:
+          taken = (Bytes)(load<Bytes>(vx + lane) == load<Bytes>(vy + lane));
+          break;
+        case OP_9XY0:
+          taken = (Bytes)(load<Bytes>(vx + lane) != load<Bytes>(vy + lane));
+          break;
+        default:
+          return false;
+      }
+
+      store(skip + lane, taken & load<Bytes>(group + lane));
+    }
+
+    return true;
+  }
+
+  /**
+   *  Returns true if every instance is at the same address, which then
+   *  becomes the common program counter.
+   */
+  bool Chip8Batch::same_program_counter()
+  {
+    for (int lane = 1; lane < instances; lane++)
+    {
+      if (program_counter[lane] != program_counter[0])
+        return false;
+    }
+
+    common_program_counter = program_counter[0];
+    return true;
+  }
+
+  /**
+   *  Returns true if every instance holds the same opcode at address.
+   */
+  template <int Width>
+  inline __attribute__((always_inline)) bool Chip8Batch::same_opcode(unsigned int address)
+  {
+    typedef typename Vector<Width>::Bytes Bytes;
+
+    const unsigned char* high = memory + address * lanes;
+    const unsigned char* low = high + lanes;
+    Bytes different = Bytes{};
+
+    for (int lane = 0; lane < lanes; lane += Width)
+    {
+      different |= (Bytes)(load<Bytes>(high + lane) != high[0]) & load<Bytes>(active + lane);
+      different |= (Bytes)(load<Bytes>(low + lane) != low[0]) & load<Bytes>(active + lane);
+    }
+
+    for (int i = 0; i < Width; i++)
+    {
+      if (different[i])
+        return false;
+    }
+
+    return true;
+  }
+
+  /**
+   *  Copies the common program counter to every lane.
+   */
+  void Chip8Batch::spread_program_counter()
+  {
+    for (int lane = 0; lane < lanes; lane++)
+      program_counter[lane] = common_program_counter;
+  }
+
+  /**
+   *  Executes one opcode on a single lane.
+   *
+   *  Mirrors the CPU opcode functions. Addresses are wrapped to the 4K
+   *  address space and pixels outside the screen are dropped, so a lane
+   *  can never write into another lane.
+   */
+  void Chip8Batch::execute_lane(int lane)
+  {
+    #define MEMORY(address) memory[((address) & 0xFFF) * lanes + lane]
+    #define REGISTER(index) V[(index) * lanes + lane]
+
+    unsigned int& pc = program_counter[lane];
+    short& i = I[lane];
+    unsigned short opcode = (MEMORY(pc) << 8) | MEMORY(pc + 1);
+    int x = (opcode & 0x0F00) >> 8;
+    int y = (opcode & 0x00F0) >> 4;
+    int nn = opcode & 0x00FF;
+    int nnn = opcode & 0x0FFF;
+    Framebuffer& screen = video[lane];
+
+    switch (decode_opcode(opcode))
+    {
+      case OP_0NNN:
+        return;
+      case OP_00CN:
+        screen.scroll_down(opcode & 0x000F);
+        break;
+      case OP_00E0:
+        screen.clear();
+        break;
+      case OP_00EE:
+        if (stack_size[lane])
+        {
+          stack_size[lane]--;
+          pc = stack[stack_size[lane] * lanes + lane];
+        }
+        break;
+      case OP_00FB:
+        screen.scroll_right();
+        break;
+      case OP_00FC:
+        screen.scroll_left();
+        break;
+      case OP_00FD:
+        reset_lane(lane);
+        break;
+      case OP_00FE:
+        screen.set_mode(Framebuffer::CHIP8);
+        break;
+      case OP_00FF:
+        screen.set_mode(Framebuffer::SUPERCHIP);
+        break;
+      case OP_1NNN:
+        pc = nnn;
+        return;
+      case OP_2NNN:
+        if (stack_size[lane] < 16)
+        {
+          stack[stack_size[lane] * lanes + lane] = pc;
+          stack_size[lane]++;
+          pc = nnn;
+          return;
+        }
+        break;
+      case OP_3XNN:
+        if ((REGISTER(x) & 0xFF) == nn)
+          pc += 2;
+        break;
+      case OP_4XNN:
+        if ((REGISTER(x) & 0xFF) != nn)
+          pc += 2;
+        break;
+      case OP_5XY0:
+        if (REGISTER(x) == REGISTER(y))
+          pc += 2;
+        break;
+      case OP_6XNN:
+        REGISTER(x) = nn;
+        break;
+      case OP_7XNN:
+        REGISTER(x) += nn;
+        break;
+      case OP_8XY0:
+        REGISTER(x) = REGISTER(y);
+        break;
+      case OP_8XY1:
+        REGISTER(x) |= REGISTER(y);
+        break;
+      case OP_8XY2:
+        REGISTER(x) &= REGISTER(y);
+        break;
+      case OP_8XY3:
+        REGISTER(x) ^= REGISTER(y);
+        break;
+      case OP_8XY4:
+        REGISTER(0xF) = ((REGISTER(x) & 0xFF) + (REGISTER(y) & 0xFF)) > 0xFF;
+        REGISTER(x) += REGISTER(y);
+        break;
+      case OP_8XY5:
+        REGISTER(0xF) = !((REGISTER(x) & 0xFF) < (REGISTER(y) & 0xFF));
+        REGISTER(x) -= REGISTER(y);
+        break;
+      case OP_8XY6:
+        REGISTER(0xF) = REGISTER(x) & 1;
+        REGISTER(x) = (REGISTER(x) & 0xFF) >> 1;
+        break;
+      case OP_8XY7:
+        REGISTER(0xF) = !(REGISTER(y) < REGISTER(x));
+        REGISTER(x) = (REGISTER(y) & 0xFF) - (REGISTER(x) & 0xFF);
+        break;
+      case OP_8XYE:
+        REGISTER(0xF) = (REGISTER(x) & 0xFF) >> 7;
+        REGISTER(x) = (REGISTER(x) & 0xFF) << 1;
+        break;
+      case OP_9XY0:
+        if (REGISTER(x) != REGISTER(y))
+          pc += 2;
+        break;
+      case OP_ANNN:
+        i = nnn;
+        break;
+      case OP_BNNN:
+        pc = REGISTER(0) + nnn;
+        return;
+      case OP_CXNN:
+        REGISTER(x) = random[lane].next_byte() & nn;
+        break;
+      case OP_DXYN:
+        {
+          REGISTER(0xF) = 0;
+
+          int lines = opcode & 0x000F;
+          int width = 8;
+
+          if (lines == 0)
+          {
+            lines = 16;
+            width = 8 << screen.get_mode();
+          }
+
+          unsigned char data[32];
+          for (int offset = 0; offset < lines * width / 8; offset++)
+            data[offset] = MEMORY(i + offset);
+
+          REGISTER(0xF) = screen.draw_sprite(REGISTER(x) & 0xFF, REGISTER(y) & 0xFF, data, lines, width);
+        }
+        break;
+      case OP_EX9E:
+        if (keys[(REGISTER(x) & 0xF) * lanes + lane])
+          pc += 2;
+        break;
+      case OP_EXA1:
+        if (!keys[(REGISTER(x) & 0xF) * lanes + lane])
+          pc += 2;
+        break;
+      case OP_FX07:
+        REGISTER(x) = delay_timer[lane];
+        break;
+      case OP_FX0A:
+        if (!key_is_pressed[lane])
+          return;
+
+        REGISTER(x) = last_key_pressed[lane];
+        key_is_pressed[lane] = false;
+        break;
+      case OP_FX15:
+        delay_timer[lane] = REGISTER(x);
+        break;
+      case OP_FX18:
+        sound_timer[lane] = REGISTER(x);
+        break;
+      case OP_FX1E:
+        i += REGISTER(x);
+        REGISTER(0xF) = i > 0xFFF;
+        break;
+      case OP_FX29:
+        i = FONT_CHIP8 + (REGISTER(x) * 5);
+        break;
+      case OP_FX30:
+        i = FONT_SUPERCHIP + (REGISTER(x) * 10);
+        break;
+      case OP_FX33:
+        memory_diverged = true;
+        MEMORY(i) = REGISTER(x) / 100;
+        MEMORY(i + 1) = (REGISTER(x) / 10) % 10;
+        MEMORY(i + 2) = REGISTER(x) % 10;
+        break;
+      case OP_FX55:
+        memory_diverged = true;
+        for (int r = 0; r <= x; r++)
+          MEMORY(i + r) = REGISTER(r);
+        i += x + 1;
+        break;
+      case OP_FX65:
+        for (int r = 0; r <= x; r++)
+          REGISTER(r) = MEMORY(i + r);
+        i += x + 1;
+        break;
+      case OP_FX75:
+        for (int r = 0; r <= x && r < 8; r++)
+          RPL[r * lanes + lane] = REGISTER(r);
+        break;
+      case OP_FX85:
+        for (int r = 0; r <= x && r < 8; r++)
+          REGISTER(r) = RPL[r * lanes + lane];
+        break;
+      default:
+        break;
+    }
+
+    pc += 2;
+
+    #undef REGISTER
+    #undef MEMORY
+  }
+
+  /**
+   *  Resets a single lane the same way Chip8::reset does.
+   */
+  void Chip8Batch::reset_lane(int lane)
+  {
+    for (int r = 0; r < 16; r++)
+    {
+      V[r * lanes + lane] = 0;
+      keys[r * lanes + lane] = false;
+    }
+
+    for (int r = 0; r < 8; r++)
+      RPL[r * lanes + lane] = 0;
+
+    I[lane] = 0;
+    program_counter[lane] = 0x200;
+    stack_size[lane] = 0;
+
+    video[lane].set_mode(Framebuffer::CHIP8);
+    video[lane].clear();
+
+    for (int address = 0; address < FONT_CHIP8; address++)
+      memory[address * lanes + lane] = 0;
+
+    for (int address = 0x200; address < 0xA00; address++)
+      memory[address * lanes + lane] = 0;
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Returns the screen of one instance as one byte per pixel, laid out
+   *  like Chip8::get_video(). The buffer is shared by all instances and is
+   *  overwritten by the next call.
+   */
+  const char* Chip8Batch::get_video(int instance)
+  {
+    video[instance].expand(pixels);
+    return pixels;
+  }
+
+  /**
+   *  Loads a game into the memory of every instance.
+   */
+  void Chip8Batch::load_game(const char* file)
+  {
+    load_game(*RomCache::load(file));
+  }
+
+  /**
+   *  Loads a game already in memory into every instance.
+   */
+  void Chip8Batch::load_game(const unsigned char* game, int length)
+  {
+    if (length > 0xE00)
+      length = 0xE00;
+
+    for (int address = 0; address < length; address++)
+      std::memset(memory + (0x200 + address) * lanes, game[address], lanes);
+  }
+
+  /**
+   *  Resets all instances to known values.
+   */
+  void Chip8Batch::reset()
+  {
+    std::memset(V, 0, 16 * lanes);
+    std::memset(RPL, 0, 8 * lanes);
+    std::memset(keys, 0, 16 * lanes);
+    std::memset(I, 0, sizeof(short) * lanes);
+    std::memset(stack_size, 0, lanes);
+
+    for (int lane = 0; lane < lanes; lane++)
+    {
+      video[lane].set_mode(Framebuffer::CHIP8);
+      video[lane].clear();
+    }
+
+    for (int lane = 0; lane < lanes; lane++)
+      program_counter[lane] = 0x200;
+
+    common_program_counter = 0x200;
+    std::memset(memory, 0, FONT_CHIP8 * lanes);
+    std::memset(memory + 0x200 * lanes, 0, 0x800 * lanes);
+
+    converged = true;
+    memory_diverged = false;
+  }
+
+  /**
+   *  Sets key state of given key for one instance.
+   */
+  void Chip8Batch::set_key(int instance, Chip8::EMU_KEYS key, bool pressed)
+  {
+    keys[(key - 1) * lanes + instance] = pressed;
+
+    if (pressed)
+    {
+      key_is_pressed[instance] = true;
+      last_key_pressed[instance] = key - 1;
+    }
+  }
+
+  /**
+   *  Steps every instance.
+   */
+  void Chip8Batch::step()
+  {
+#if defined(__x86_64__)
+    if (avx2)
+      execute_avx2(cpu_cycles);
+    else
+      execute<16>(cpu_cycles);
+#else
+    execute<16>(cpu_cycles);
+#endif
+
+    for (int lane = 0; lane < lanes; lane++)
+    {
+      if (delay_timer[lane] > 0)
+        delay_timer[lane]--;
+
+      if (sound_timer[lane] > 0)
+        sound_timer[lane]--;
+    }
+  }
+}
@@ -0,0 +1,233 @@
+#if defined(__linux__)
+#include <pthread.h>
+#include <sched.h>
+#endif
+
+#include "../include/EmulatorPool.h"
+
+namespace YACE
+{
+  namespace
+  {
+    /**
+     *  Pins thread to the index-th core the process may run on, wrapping
+     *  around when there are more threads than cores.
+     */
+    void pin_thread(std::thread& thread, int index)
+    {
+#if defined(__linux__)
+      cpu_set_t allowed;
+      if (sched_getaffinity(0, sizeof(allowed), &allowed) != 0 || CPU_COUNT(&allowed) == 0)
+        return;
+
+      int target = index % CPU_COUNT(&allowed);
+      for (int core = 0; core < CPU_SETSIZE; core++)
+      {
+        if (!CPU_ISSET(core, &allowed) || target--)
+          continue;
+
+        cpu_set_t cpus;
+        CPU_ZERO(&cpus);
+        CPU_SET(core, &cpus);
+        pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus);
+        return;
+      }
+#endif
+    }
+  }
+
+  /**
+   *  Creates instances Chip8s and threads workers, one per core if
+   *  threads is 0.
+   */
+  EmulatorPool::EmulatorPool(int instances, int threads) : instances(instances), threads(threads), queued(0), sleeping(0), stopping(false)
+  {
+    if (instances < 1)
+      throw "Invalid number of instances!";
+
+    if (this->threads < 1)
+      this->threads = std::thread::hardware_concurrency();
+    if (this->threads < 1)
+      this->threads = 1;
+
+    slots = new Slot[instances];
+    for (int id = 0; id < instances; id++)
+      slots[id].queued = false;
+
+    workers = new Worker[this->threads];
+    for (int worker = 0; worker < this->threads; worker++)
+    {
+      workers[worker].thread = std::thread(&EmulatorPool::run, this, worker);
+      pin_thread(workers[worker].thread, worker);
+    }
+  }
+
+  /**
+   *  Finishes every queued task, then stops the workers.
+   */
+  EmulatorPool::~EmulatorPool()
+  {
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      stopping = true;
+    }
+    wake.notify_all();
+
+    for (int worker = 0; worker < threads; worker++)
+      workers[worker].thread.join();
+
+    delete[] workers;
+    delete[] slots;
+  }
+
+  /*
+   *  Private methods
+   */
+  void EmulatorPool::check_instance(int id) const
+  {
+    if (id < 0 || id >= instances)
+      throw "Invalid instance!";
+  }
+
+  /**
+   *  Adds task to an instance's tasks, queueing the instance on the worker
+   *  it belongs to if it has no other tasks.
+   */
+  void EmulatorPool::enqueue(int id, std::function<void()> task)
+  {
+    check_instance(id);
+
+    Slot& slot = slots[id];
+    {
+      std::lock_guard<std::mutex> lock(slot.mutex);
+
+      slot.tasks.push_back(std::move(task));
+      if (slot.queued)
+        return;
+
+      slot.queued = true;
+    }
+
+    push(id % threads, id);
+  }
+
+  void EmulatorPool::push(int worker, int id)
+  {
+    {
+      std::lock_guard<std::mutex> lock(workers[worker].mutex);
+      workers[worker].queue.push_back(id);
+
+      // Counted under the same lock take() decrements it with, so it
+      // never drops below zero
+      queued++;
+    }
+
+    // A worker about to sleep either sees queued or is woken
+    if (sleeping > 0)
+    {
+      std::lock_guard<std::mutex> lock(sleep_mutex);
+      wake.notify_one();
+    }
+  }
+
+  /**
+   *  Worker loop, runs one task at a time and queues the instance again
+   *  behind the others if it has more.
+   */
+  void EmulatorPool::run(int worker)
+  {
+    for (int id; take(worker, id); )
+    {
+      Slot& slot = slots[id];
+      std::function<void()> task;
+
+      {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        task = std::move(slot.tasks.front());
+        slot.tasks.pop_front();
+      }
+
+      task();
+
+      {
+        std::lock_guard<std::mutex> lock(slot.mutex);
+        if (slot.tasks.empty())
+        {
+          slot.queued = false;
+          continue;
+        }
+      }
+
+      push(worker, id);
+    }
+  }
+
+  /**
+   *  Takes the oldest instance from the worker's own queue, otherwise the
+   *  newest from another worker's, sleeping while there are none. Returns
+   *  false once the pool is stopping and no work is left.
+   */
+  bool EmulatorPool::take(int worker, int& id)
+  {
+    for (;;)
+    {
+      for (int i = 0; i < threads; i++)
+      {
+        Worker& victim = workers[(worker + i) % threads];
+        std::lock_guard<std::mutex> lock(victim.mutex);
+
+        if (victim.queue.empty())
+          continue;
+
+        if (i == 0)
+        {
+          id = victim.queue.front();
+          victim.queue.pop_front();
+        }
+        else
+        {
+          id = victim.queue.back();
+          victim.queue.pop_back();
+        }
+
+        queued--;
+        return true;
+      }
+
+      std::unique_lock<std::mutex> lock(sleep_mutex);
+
+      sleeping++;
+      wake.wait(lock, [this]() {return queued > 0 || stopping;});
+      sleeping--;
+
+      if (queued == 0)
+        return false;
+    }
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Steps an instance frames times and returns its state after every
+   *  frame. Dirty regions are taken from the instance.
+   */
+  std::future<std::vector<EmulatorPool::Frame> > EmulatorPool::run_frames(int id, int frames)
+  {
+    return submit(id, [frames](Chip8& chip8)
+    {
+      std::vector<Frame> results;
+      results.reserve(frames > 0 ? frames : 0);
+
+      for (int i = 0; i < frames; i++)
+      {
+        chip8.step();
+
+        Frame frame = {chip8.get_cycles(), chip8.get_dirty_region(), chip8.get_sound_timer(), chip8.is_idle()};
+        results.push_back(frame);
+      }
+
+      return results;
+    });
+  }
+}
@@ -0,0 +1,214 @@
+#include <cstring>
+
+#include "../include/Framebuffer.h"
+
+namespace YACE
+{
+  namespace
+  {
+    /**
+     *  Counts leading zero bits of a non-zero row.
+     */
+    int leading_zeros(Framebuffer::Row row)
+    {
+      unsigned long long high = row >> 64;
+      return high ? __builtin_clzll(high) : 64 + __builtin_clzll((unsigned long long)row);
+    }
+
+    /**
+     *  Counts trailing zero bits of a non-zero row.
+     */
+    int trailing_zeros(Framebuffer::Row row)
+    {
+      unsigned long long low = row;
+      return low ? __builtin_ctzll(low) : 64 + __builtin_ctzll((unsigned long long)(row >> 64));
+    }
+
+    /**
+     *  SplitMix64 finalizer.
+     */
+    unsigned long long mix(unsigned long long value)
+    {
+      value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ULL;
+      value = (value ^ (value >> 27)) * 0x94D049BB133111EBULL;
+      return value ^ (value >> 31);
+    }
+
+    /**
+     *  Hashes the pixels of row y, so equal rows at different heights
+     *  hash differently.
+     */
+    unsigned long long hash_row(int y, Framebuffer::Row row)
+    {
+      return mix(mix((unsigned long long)(row >> 64) + y * 0x9E3779B97F4A7C15ULL) ^ (unsigned long long)row);
+    }
+  }
+
+  Framebuffer::Framebuffer() : mode(CHIP8), revision(0), dirty_rows(0), dirty_columns(0), mode_changed(false),
+                               hash(0), stale_rows(~0ULL)
+  {
+    std::memset(rows, 0, sizeof(rows));
+    std::memset(row_hashes, 0, sizeof(row_hashes));
+  }
+
+  /**
+   *  Turns off every pixel.
+   */
+  void Framebuffer::clear()
+  {
+    Row mask = screen_mask();
+
+    for (int y = 0; y < get_height(); y++)
+      mark_dirty(y, rows[y] & mask);
+
+    std::memset(rows, 0, sizeof(rows));
+    revision++;
+  }
+
+  /**
+   *  Writes one byte per pixel to destination, using the row pitch of the
+   *  current mode. Bytes after the last row are cleared, so destination
+   *  must hold 0x2000 bytes.
+   */
+  void Framebuffer::expand(char* destination) const
+  {
+    int width = get_width();
+    int height = get_height();
+
+    for (int y = 0; y < height; y++)
+    {
+      Row row = rows[y];
+
+      for (int x = 0; x < width; x++)
+        *(destination++) = (row >> (127 - x)) & 1;
+    }
+
+    std::memset(destination, 0, 0x2000 - width * height);
+  }
+
+  /**
+   *  Returns a 64-bit hash of the visible pixels and the mode. Equal
+   *  screens have equal hashes, whatever was drawn outside of them. Only
+   *  rows changed since the last call are hashed again.
+   */
+  unsigned long long Framebuffer::get_hash()
+  {
+    Row mask = screen_mask();
+
+    while (stale_rows)
+    {
+      int y = __builtin_ctzll(stale_rows);
+
+      hash ^= row_hashes[y];
+      row_hashes[y] = y < get_height() ? hash_row(y, rows[y] & mask) : 0;
+      hash ^= row_hashes[y];
+      stale_rows &= stale_rows - 1;
+    }
+
+    return hash ^ mix(mode);
+  }
+
+  /**
+   *  Replaces all 64 rows and the mode. The whole screen becomes dirty.
+   */
+  void Framebuffer::load(const Row* rows, MODES mode)
+  {
+    std::memcpy(this->rows, rows, sizeof(this->rows));
+    this->mode = mode;
+    revision++;
+    mark_screen_dirty();
+  }
+
+  /**
+   *  Scrolls the screen down the given number of lines.
+   */
+  void Framebuffer::scroll_down(int lines)
+  {
+    int height = get_height();
+    Row mask = screen_mask();
+
+    if (lines > height)
+      lines = height;
+
+    for (int y = height - 1; y >= 0; y--)
+    {
+      Row row = y >= lines ? rows[y - lines] : 0;
+      mark_dirty(y, (rows[y] ^ row) & mask);
+      rows[y] = row;
+    }
+
+    revision++;
+  }
+
+  /**
+   *  Scrolls the screen 4 pixels left (2 pixels in Chip-8 mode).
+   */
+  void Framebuffer::scroll_left()
+  {
+    int pixels = 2 << mode;
+    Row mask = screen_mask();
+
+    for (int y = 0; y < get_height(); y++)
+    {
+      Row row = (rows[y] << pixels) & mask;
+      mark_dirty(y, (rows[y] ^ row) & mask);
+      rows[y] = row;
+    }
+
+    revision++;
+  }
+
+  /**
+   *  Scrolls the screen 4 pixels right (2 pixels in Chip-8 mode).
+   */
+  void Framebuffer::scroll_right()
+  {
+    int pixels = 2 << mode;
+    Row mask = screen_mask();
+
+    for (int y = 0; y < get_height(); y++)
+    {
+      Row row = (rows[y] >> pixels) & mask;
+      mark_dirty(y, (rows[y] ^ row) & mask);
+      rows[y] = row;
+    }
+
+    revision++;
+  }
+
+  /**
+   *  Switches between Chip-8 and SuperChip resolution. Pixels keep their
+   *  coordinates. The whole screen becomes dirty.
+   */
+  void Framebuffer::set_mode(MODES mode)
+  {
+    if (this->mode != mode)
+    {
+      this->mode = mode;
+      revision++;
+      mark_screen_dirty();
+    }
+  }
+
+  /**
+   *  Returns the pixels changed since the last call and starts tracking
+   *  again. Pixels flipped twice in between are still reported.
+   */
+  Framebuffer::DirtyRegion Framebuffer::take_dirty_region()
+  {
+    DirtyRegion region = {dirty_rows, 0, 0, 0, 0, mode_changed};
+
+    if (dirty_rows)
+    {
+      region.y = __builtin_ctzll(dirty_rows);
+      region.height = 64 - __builtin_clzll(dirty_rows) - region.y;
+      region.x = leading_zeros(dirty_columns);
+      region.width = 128 - trailing_zeros(dirty_columns) - region.x;
+    }
+
+    dirty_rows = 0;
+    dirty_columns = 0;
+    mode_changed = false;
+    return region;
+  }
+}
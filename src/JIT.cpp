@@ -0,0 +1,415 @@
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <sys/mman.h>
+#endif
+
+#include "../include/JIT.h"
+#include "../include/Opcodes.h"
+
+namespace YACE
+{
+  namespace
+  {
+    const unsigned int CODE_SIZE = 0x40000;
+    const unsigned int MAX_BLOCK_SIZE = 0x800;  // Upper bound of native code per block
+    const int MAX_BLOCK_LENGTH = 64;
+
+    enum BLOCK_STATES {BLOCK_NONE, BLOCK_READY, BLOCK_UNSUPPORTED};
+
+    /**
+     *  Writes machine code into the code buffer.
+     */
+    class Emitter
+    {
+      public:
+        Emitter(unsigned char* code) : start(code), position(code) {}
+
+        void byte(unsigned char value) {*(position++) = value;}
+        void bytes(unsigned char a, unsigned char b) {byte(a); byte(b);}
+        void bytes(unsigned char a, unsigned char b, unsigned char c) {byte(a); byte(b); byte(c);}
+        void dword(unsigned int value)
+        {
+          for (int i = 0; i < 4; i++)
+            byte(value >> (i * 8));
+        }
+        unsigned int size() {return position - start;}
+
+      private:
+        unsigned char* start;
+        unsigned char* position;
+    };
+  }
+
+  struct JIT::Cache
+  {
+    unsigned char* code;
+    unsigned int code_used;
+    bool writable;                    // Code is mapped for writing, not executing
+    Block blocks[0x1000];
+    unsigned char state[0x1000];
+    unsigned short coverage[0x1000];  // Number of blocks covering each address
+  };
+
+  JIT::JIT() : cache(0), shift_vy(false)
+  {
+  }
+
+  /**
+   *  Translated code is derived state, so a copy starts out empty.
+   */
+  JIT::JIT(const JIT& other) : cache(0), shift_vy(other.shift_vy)
+  {
+  }
+
+  JIT::~JIT()
+  {
+    if (cache)
+    {
+#if defined(__x86_64__)
+      if (cache->code)
+        munmap(cache->code, CODE_SIZE);
+#endif
+      delete cache;
+    }
+  }
+
+  JIT& JIT::operator=(const JIT& other)
+  {
+    flush();
+    shift_vy = other.shift_vy;
+    return *this;
+  }
+
+  /*
+   *  Private methods
+   */
+  /**
+   *  Translates the block starting at address.
+   */
+  bool JIT::compile(const unsigned char* memory, unsigned int address)
+  {
+#if defined(__x86_64__)
+    if (!cache->code || !set_writable(true))
+      return false;
+
+    if (cache->code_used + MAX_BLOCK_SIZE > CODE_SIZE)
+      flush();
+
+    // Calling convention: rdi = V, rsi = &I, rdx = &program_counter
+    Emitter emit(cache->code + cache->code_used);
+    unsigned int pc = address;
+    int length = 0;
+    bool terminated = false;
+    bool returned = false;
+
+    while (!terminated && length < MAX_BLOCK_LENGTH && pc <= 0xFFE)
+    {
+      unsigned short opcode = (memory[pc] << 8) | memory[pc + 1];
+      unsigned char x = (opcode & 0x0F00) >> 8;
+      unsigned char y = (opcode & 0x00F0) >> 4;
+      unsigned char nn = opcode & 0x00FF;
+      unsigned char condition = 0;
+
+      switch (decode_opcode(opcode))
+      {
+        case OP_6XNN:   // mov byte [rdi + x], nn
+          emit.bytes(0xC6, 0x47, x);
+          emit.byte(nn);
+          break;
+        case OP_7XNN:   // add byte [rdi + x], nn
+          emit.bytes(0x80, 0x47, x);
+          emit.byte(nn);
+          break;
+        case OP_8XY0:   // mov al, [rdi + y]; mov [rdi + x], al
+          emit.bytes(0x8A, 0x47, y);
+          emit.bytes(0x88, 0x47, x);
+          break;
+        case OP_8XY1:   // mov al, [rdi + y]; or [rdi + x], al
+          emit.bytes(0x8A, 0x47, y);
+          emit.bytes(0x08, 0x47, x);
+          break;
+        case OP_8XY2:   // mov al, [rdi + y]; and [rdi + x], al
+          emit.bytes(0x8A, 0x47, y);
+          emit.bytes(0x20, 0x47, x);
+          break;
+        case OP_8XY3:   // mov al, [rdi + y]; xor [rdi + x], al
+          emit.bytes(0x8A, 0x47, y);
+          emit.bytes(0x30, 0x47, x);
+          break;
+        case OP_8XY4:   // VF = carry of VX + VY, then VX += VY
+          emit.bytes(0x8A, 0x47, x);        // mov al, [rdi + x]
+          emit.bytes(0x02, 0x47, y);        // add al, [rdi + y]
+          emit.bytes(0x0F, 0x92, 0xC1);     // setc cl
+          emit.bytes(0x88, 0x4F, 0x0F);     // mov [rdi + 15], cl
+          emit.bytes(0x8A, 0x47, y);        // mov al, [rdi + y]
+          emit.bytes(0x00, 0x47, x);        // add [rdi + x], al
+          break;
+        case OP_8XY5:   // VF = VX >= VY, then VX -= VY
+          emit.bytes(0x8A, 0x47, x);        // mov al, [rdi + x]
+          emit.bytes(0x3A, 0x47, y);        // cmp al, [rdi + y]
+          emit.bytes(0x0F, 0x93, 0xC1);     // setae cl
+          emit.bytes(0x88, 0x4F, 0x0F);     // mov [rdi + 15], cl
+          emit.bytes(0x8A, 0x47, y);        // mov al, [rdi + y]
+          emit.bytes(0x28, 0x47, x);        // sub [rdi + x], al
+          break;
+        case OP_8XY6:   // VF = VX & 1, then VX >>= 1
+          if (shift_vy)
+          {
+            // VF = VY & 1, then VX = VY >> 1
+            emit.bytes(0x8A, 0x47, y);      // mov al, [rdi + y]
+            emit.bytes(0x24, 0x01);         // and al, 1
+            emit.bytes(0x88, 0x47, 0x0F);   // mov [rdi + 15], al
+            emit.bytes(0x8A, 0x47, y);      // mov al, [rdi + y]
+            emit.bytes(0xD0, 0xE8);         // shr al, 1
+            emit.bytes(0x88, 0x47, x);      // mov [rdi + x], al
+            break;
+          }
+          emit.bytes(0x8A, 0x47, x);        // mov al, [rdi + x]
+          emit.bytes(0x24, 0x01);           // and al, 1
+          emit.bytes(0x88, 0x47, 0x0F);     // mov [rdi + 15], al
+          emit.bytes(0xD0, 0x6F, x);        // shr byte [rdi + x], 1
+          break;
+        case OP_8XYE:   // VF = VX >> 7, then VX <<= 1
+          if (shift_vy)
+          {
+            // VF = VY >> 7, then VX = VY << 1
+            emit.bytes(0x8A, 0x47, y);      // mov al, [rdi + y]
+            emit.bytes(0xC0, 0xE8, 0x07);   // shr al, 7
+            emit.bytes(0x88, 0x47, 0x0F);   // mov [rdi + 15], al
+            emit.bytes(0x8A, 0x47, y);      // mov al, [rdi + y]
+            emit.bytes(0xD0, 0xE0);         // shl al, 1
+            emit.bytes(0x88, 0x47, x);      // mov [rdi + x], al
+            break;
+          }
+          emit.bytes(0x8A, 0x47, x);        // mov al, [rdi + x]
+          emit.bytes(0xC0, 0xE8, 0x07);     // shr al, 7
+          emit.bytes(0x88, 0x47, 0x0F);     // mov [rdi + 15], al
+          emit.bytes(0xD0, 0x67, x);        // shl byte [rdi + x], 1
+          break;
+        case OP_ANNN:   // mov word [rsi], nnn
+          emit.bytes(0x66, 0xC7, 0x06);
+          emit.bytes(opcode & 0xFF, (opcode & 0x0F00) >> 8);
+          break;
+        case OP_1NNN:   // mov dword [rdx], nnn; ret
+          emit.bytes(0xC7, 0x02);
+          emit.dword(opcode & 0x0FFF);
+          emit.byte(0xC3);
+          terminated = returned = true;
+          break;
+        case OP_3XNN:   // cmp byte [rdi + x], nn
+          emit.bytes(0x80, 0x7F, x);
+          emit.byte(nn);
+          condition = 0x44;                 // cmove
+          break;
+        case OP_4XNN:
+          emit.bytes(0x80, 0x7F, x);
+          emit.byte(nn);
+          condition = 0x45;                 // cmovne
+          break;
+        case OP_5XY0:   // mov r8b, [rdi + x]; cmp r8b, [rdi + y]
+          emit.bytes(0x44, 0x8A, 0x47);
+          emit.byte(x);
+          emit.bytes(0x44, 0x3A, 0x47);
+          emit.byte(y);
+          condition = 0x44;
+          break;
+        case OP_9XY0:
+          emit.bytes(0x44, 0x8A, 0x47);
+          emit.byte(x);
+          emit.bytes(0x44, 0x3A, 0x47);
+          emit.byte(y);
+          condition = 0x45;
+          break;
+        default:
+          // Leave the opcode to the interpreter
+          terminated = true;
+          continue;
+      }
+
+      if (condition)
+      {
+        // Select between the next and the skipped instruction
+        emit.byte(0xB8);                    // mov eax, pc + 2
+        emit.dword(pc + 2);
+        emit.byte(0xB9);                    // mov ecx, pc + 4
+        emit.dword(pc + 4);
+        emit.bytes(0x0F, condition, 0xC1);  // cmovcc eax, ecx
+        emit.bytes(0x89, 0x02);             // mov [rdx], eax
+        emit.byte(0xC3);                    // ret
+        terminated = returned = true;
+      }
+
+      length++;
+      pc += 2;
+    }
+
+    if (length == 0)
+      return false;
+
+    if (!returned)
+    {
+      // Continue with the opcode after the block
+      emit.bytes(0xC7, 0x02);               // mov dword [rdx], pc
+      emit.dword(pc);
+      emit.byte(0xC3);                      // ret
+    }
+
+    Block& block = cache->blocks[address];
+    block.code = (Code)(cache->code + cache->code_used);
+    block.start = address;
+    block.end = pc;
+    block.length = length;
+
+    cache->code_used += (emit.size() + 15) & ~15;
+    cache->state[address] = BLOCK_READY;
+
+    for (unsigned int i = address; i < pc; i++)
+      cache->coverage[i]++;
+
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /**
+   *  Removes the block starting at address.
+   */
+  void JIT::drop(unsigned int address)
+  {
+    Block& block = cache->blocks[address];
+
+    for (unsigned int i = block.start; i < block.end; i++)
+      cache->coverage[i]--;
+
+    cache->state[address] = BLOCK_NONE;
+  }
+
+  /**
+   *  Maps the code buffer for writing or for executing, never both.
+   *  Returns false if it couldn't be changed.
+   */
+  bool JIT::set_writable(bool writable)
+  {
+#if defined(__x86_64__)
+    if (cache->writable == writable)
+      return true;
+
+    if (mprotect(cache->code, CODE_SIZE, writable ? PROT_READ | PROT_WRITE : PROT_READ | PROT_EXEC) != 0)
+      return false;
+
+    cache->writable = writable;
+    return true;
+#else
+    return false;
+#endif
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Removes all translated blocks.
+   */
+  void JIT::flush()
+  {
+    if (!cache)
+      return;
+
+    cache->code_used = 0;
+    std::memset(cache->state, BLOCK_NONE, sizeof(cache->state));
+    std::memset(cache->coverage, 0, sizeof(cache->coverage));
+  }
+
+  /**
+   *  Returns the block starting at address, translating it if needed.
+   *  Returns 0 if no block can be built there.
+   */
+  const JIT::Block* JIT::get_block(const unsigned char* memory, unsigned int address)
+  {
+    if (address > 0xFFE)
+      return 0;
+
+    if (!cache)
+    {
+      cache = new Cache();
+      cache->code = 0;
+      cache->code_used = 0;
+      cache->writable = true;
+      std::memset(cache->state, BLOCK_NONE, sizeof(cache->state));
+      std::memset(cache->coverage, 0, sizeof(cache->coverage));
+
+#if defined(__x86_64__)
+      void* code = mmap(0, CODE_SIZE, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+      if (code != MAP_FAILED)
+        cache->code = (unsigned char*)code;
+#endif
+    }
+
+    switch (cache->state[address])
+    {
+      case BLOCK_READY:
+        return &cache->blocks[address];
+      case BLOCK_UNSUPPORTED:
+        return 0;
+    }
+
+    bool compiled = compile(memory, address);
+
+    // Code only runs once it can no longer be written
+    if (cache->code && !set_writable(false))
+    {
+      flush();
+      compiled = false;
+    }
+
+    if (compiled)
+      return &cache->blocks[address];
+
+    cache->state[address] = BLOCK_UNSUPPORTED;
+    return 0;
+  }
+
+  /**
+   *  Drops every block affected by a write to memory.
+   */
+  void JIT::invalidate(unsigned int address, unsigned int length)
+  {
+    if (!cache)
+      return;
+
+    for (unsigned int i = address; i < address + length; i++)
+    {
+      unsigned int written = i & 0xFFF;
+
+      // An opcode starting one byte earlier may have changed as well
+      if (written > 0 && cache->state[written - 1] == BLOCK_UNSUPPORTED)
+        cache->state[written - 1] = BLOCK_NONE;
+      if (cache->state[written] == BLOCK_UNSUPPORTED)
+        cache->state[written] = BLOCK_NONE;
+
+      if (!cache->coverage[written])
+        continue;
+
+      unsigned int first = written > MAX_BLOCK_LENGTH * 2 ? written - MAX_BLOCK_LENGTH * 2 : 0;
+      for (unsigned int start = first; start <= written; start++)
+      {
+        if (cache->state[start] == BLOCK_READY && cache->blocks[start].end > written)
+          drop(start);
+      }
+    }
+  }
+
+  /**
+   *  Selects how 8XY6 and 8XYE are translated, dropping translated code
+   *  if it changes.
+   */
+  void JIT::set_shift_vy(bool shift_vy)
+  {
+    if (shift_vy != this->shift_vy)
+      flush();
+
+    this->shift_vy = shift_vy;
+  }
+}
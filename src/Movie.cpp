@@ -0,0 +1,315 @@
+#include <climits>
+#include <cstdio>
+#include <cstring>
+
+#include "../include/Movie.h"
+
+namespace YACE
+{
+  Movie::Movie() : mode(STOPPED), chip8(0), start_cycle(0), last_cycle(0), position(0), has_next(false),
+                   checkpoints(0), mismatches(0), first_mismatch(0)
+  {
+    std::memset(&header, 0, sizeof(header));
+    std::memset(&start, 0, sizeof(start));
+  }
+
+  /*
+   *  Private methods
+   */
+  /**
+   *  Appends an entry due cycle cycles after the start. A checkpoint's
+   *  hash is appended by the caller.
+   */
+  void Movie::append(unsigned long long cycle, unsigned char flags)
+  {
+    unsigned long long delta = cycle - last_cycle;
+
+    for (; delta >= 0x80; delta >>= 7)
+      input.push_back(0x80 | (delta & 0x7F));
+
+    input.push_back(delta);
+    input.push_back(flags);
+    last_cycle = cycle;
+  }
+
+  /**
+   *  Applies the entries due at the current cycle of the Chip8 played
+   *  back to, and returns the cycle the next one is due, or ULLONG_MAX if
+   *  there is none or input is being recorded.
+   */
+  unsigned long long Movie::play_input()
+  {
+    if (mode != PLAYING)
+      return ULLONG_MAX;
+
+    unsigned long long now = chip8->get_cycles() - start_cycle;
+
+    while (has_next && next.cycle <= now)
+    {
+      if (next.flags & MovieHeader::CHECKPOINT)
+      {
+        checkpoints++;
+
+        if (chip8->state_hash() != next.hash && mismatches++ == 0)
+          first_mismatch = next.cycle;
+      }
+      else
+        chip8->press_key(Chip8::EMU_KEYS(Chip8::KEY_0 + (next.flags & 0x0F)), next.flags & MovieHeader::PRESSED);
+
+      has_next = read_entry(position, next.cycle, next);
+    }
+
+    return has_next ? start_cycle + next.cycle : ULLONG_MAX;
+  }
+
+  /**
+   *  Decodes the entry at position, following one due at cycle previous,
+   *  and moves position past it. Returns false at the end of the input or
+   *  if the entry is cut short.
+   */
+  bool Movie::read_entry(unsigned int& position, unsigned long long previous, Entry& entry) const
+  {
+    unsigned long long delta = 0;
+
+    for (int shift = 0; ; shift += 7)
+    {
+      if (position >= input.size() || shift > 63)
+        return false;
+
+      unsigned char byte = input[position++];
+      delta |= (unsigned long long)(byte & 0x7F) << shift;
+
+      if (!(byte & 0x80))
+        break;
+    }
+
+    if (position >= input.size())
+      return false;
+
+    entry.cycle = previous + delta;
+    entry.flags = input[position++];
+    entry.hash = 0;
+
+    if (entry.flags & MovieHeader::CHECKPOINT)
+    {
+      if (input.size() - position < 8)
+        return false;
+
+      for (int i = 7; i >= 0; i--)
+        entry.hash = (entry.hash << 8) | input[position + i];
+
+      position += 8;
+    }
+
+    return true;
+  }
+
+  /**
+   *  Logs a key change made by the caller. Returns false if the keys come
+   *  from the movie instead.
+   */
+  bool Movie::record_key(unsigned long long cycle, Chip8::EMU_KEYS key, bool pressed)
+  {
+    if (mode != RECORDING)
+      return false;
+
+    append(cycle - start_cycle, (key - Chip8::KEY_0) | (pressed ? MovieHeader::PRESSED : 0));
+    return true;
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Records the state hash of the Chip8 at its current cycle, which
+   *  playback compares with the state it reaches there.
+   */
+  void Movie::checkpoint()
+  {
+    if (mode != RECORDING)
+      throw "Movie isn't recording!";
+
+    unsigned long long hash = chip8->state_hash();
+
+    append(chip8->get_cycles() - start_cycle, MovieHeader::CHECKPOINT);
+    for (int i = 0; i < 8; i++)
+      input.push_back(hash >> (i * 8));
+
+    checkpoints++;
+  }
+
+  /**
+   *  Returns the cycles recorded so far.
+   */
+  unsigned long long Movie::get_length() const
+  {
+    return mode == RECORDING ? chip8->get_cycles() - start_cycle : header.length;
+  }
+
+  /**
+   *  Returns whether playback applied all of the input and ran for the
+   *  length recorded, or isn't running.
+   */
+  bool Movie::is_finished() const
+  {
+    return mode != PLAYING || (!has_next && chip8->get_cycles() - start_cycle >= header.length);
+  }
+
+  /**
+   *  Reads a movie written by save.
+   */
+  void Movie::load(const char* file)
+  {
+    stop();
+
+    FILE* source = fopen(file, "rb");
+    if (!source)
+      throw "Couldn't open specified file!";
+
+    MovieHeader read_header;
+    bool valid = fread(&read_header, sizeof(read_header), 1, source) == 1 &&
+                 fread(&start, sizeof(SaveState), 1, source) == 1;
+
+    input.clear();
+
+    unsigned char buffer[4096];
+    for (size_t count; valid && (count = fread(buffer, 1, sizeof(buffer), source)) > 0; )
+      input.insert(input.end(), buffer, buffer + count);
+
+    fclose(source);
+
+    valid = valid && read_header.magic == MovieHeader::MAGIC && read_header.version == MovieHeader::VERSION &&
+            read_header.state_size == sizeof(SaveState) && read_header.input_size == input.size() &&
+            read_header.cpu_frequency && read_header.timer_frequency &&
+            read_header.quirks < QUIRK_PROFILE_COUNT && start.is_valid();
+
+    // Every entry is whole, known and within the length
+    Entry entry = {0, 0, 0};
+    unsigned int checked = 0;
+
+    while (valid && checked < input.size())
+    {
+      valid = read_entry(checked, entry.cycle, entry) && !(entry.flags & 0xC0) &&
+              entry.cycle <= read_header.length;
+    }
+
+    if (!valid)
+    {
+      std::memset(&header, 0, sizeof(header));
+      input.clear();
+      throw "Invalid movie!";
+    }
+
+    header = read_header;
+  }
+
+  /**
+   *  Restores chip8 to the start of the movie, with the settings it was
+   *  recorded with, and plays the input back from there. The engine is
+   *  left as it is.
+   */
+  void Movie::play(Chip8& chip8)
+  {
+    if (header.magic != MovieHeader::MAGIC)
+      throw "No movie to play!";
+
+    stop();
+    if (chip8.movie)
+      chip8.movie->stop();
+
+    chip8.set_seed(header.seed);
+    chip8.set_quirks(QUIRK_PROFILES(header.quirks));
+    chip8.set_timer_frequency(header.timer_frequency);
+    chip8.set_cpu_frequency(header.cpu_frequency);
+    chip8.load_state(start);
+    chip8.rom_hash = header.rom_hash;
+
+    position = 0;
+    has_next = read_entry(position, 0, next);
+    checkpoints = 0;
+    mismatches = 0;
+    first_mismatch = 0;
+
+    this->chip8 = &chip8;
+    start_cycle = chip8.get_cycles();
+    chip8.movie = this;
+    mode = PLAYING;
+  }
+
+  /**
+   *  Starts a new movie from the current state of chip8, logging its
+   *  key changes until stop().
+   */
+  void Movie::record(Chip8& chip8)
+  {
+    stop();
+    if (chip8.movie)
+      chip8.movie->stop();
+
+    // Start a timer period, as loading the state does for playback
+    chip8.save_state(start);
+    chip8.restart_timer_period();
+
+    std::memset(&header, 0, sizeof(header));
+    header.magic = MovieHeader::MAGIC;
+    header.version = MovieHeader::VERSION;
+    header.state_size = sizeof(SaveState);
+    header.rom_hash = chip8.get_rom_hash();
+    header.seed = chip8.get_seed();
+    header.cpu_frequency = chip8.get_cpu_frequency();
+    header.timer_frequency = chip8.get_timer_frequency();
+    header.quirks = chip8.get_quirks();
+
+    input.clear();
+    last_cycle = 0;
+    checkpoints = 0;
+    mismatches = 0;
+    first_mismatch = 0;
+
+    this->chip8 = &chip8;
+    start_cycle = chip8.get_cycles();
+    chip8.movie = this;
+    mode = RECORDING;
+  }
+
+  /**
+   *  Writes the movie to a file, up to the current cycle if it is still
+   *  being recorded.
+   */
+  void Movie::save(const char* file) const
+  {
+    if (header.magic != MovieHeader::MAGIC)
+      throw "No movie to save!";
+
+    MovieHeader written_header = header;
+    written_header.length = get_length();
+    written_header.input_size = input.size();
+
+    FILE* output = fopen(file, "wb");
+    bool written = output && fwrite(&written_header, sizeof(written_header), 1, output) == 1 &&
+                   fwrite(&start, sizeof(SaveState), 1, output) == 1 &&
+                   fwrite(input.data(), 1, input.size(), output) == input.size();
+
+    if (output && fclose(output) != 0)
+      written = false;
+
+    if (!written)
+      throw "Couldn't write specified file!";
+  }
+
+  /**
+   *  Ends recording or playback and detaches from the Chip8.
+   */
+  void Movie::stop()
+  {
+    if (mode == STOPPED)
+      return;
+
+    if (mode == RECORDING)
+      header.length = chip8->get_cycles() - start_cycle;
+
+    chip8->movie = 0;
+    chip8 = 0;
+    mode = STOPPED;
+  }
+}
@@ -0,0 +1,195 @@
+#include <cstdio>
+
+#include "../include/Opcodes.h"
+
+namespace YACE
+{
+  namespace
+  {
+    // Indexed by OPCODES
+    const char* const names[OPCODE_COUNT] =
+    {
+      "0NNN", "00CN", "00E0", "00EE", "00FB", "00FC", "00FD", "00FE", "00FF",
+      "1NNN", "2NNN", "3XNN", "4XNN", "5XY0", "6XNN", "7XNN",
+      "8XY0", "8XY1", "8XY2", "8XY3", "8XY4", "8XY5", "8XY6", "8XY7", "8XYE",
+      "9XY0", "ANNN", "BNNN", "CXNN", "DXYN", "EX9E", "EXA1",
+      "FX07", "FX0A", "FX15", "FX18", "FX1E", "FX29", "FX30", "FX33",
+      "FX55", "FX65", "FX75", "FX85",
+      "UNKNOWN"
+    };
+
+    // Operands printed by a mnemonic
+    enum OPERANDS {NONE, N, NNN, X, XNN, XY, XYN, RAW};
+
+    struct Mnemonic
+    {
+      const char* format;
+      OPERANDS operands;
+    };
+
+    // Indexed by OPCODES
+    const Mnemonic mnemonics[OPCODE_COUNT] =
+    {
+      {"SYS %03X", NNN}, {"SCD %X", N}, {"CLS", NONE}, {"RET", NONE},
+      {"SCR", NONE}, {"SCL", NONE}, {"EXIT", NONE}, {"LOW", NONE}, {"HIGH", NONE},
+      {"JP %03X", NNN}, {"CALL %03X", NNN}, {"SE V%X, %02X", XNN}, {"SNE V%X, %02X", XNN},
+      {"SE V%X, V%X", XY}, {"LD V%X, %02X", XNN}, {"ADD V%X, %02X", XNN},
+      {"LD V%X, V%X", XY}, {"OR V%X, V%X", XY}, {"AND V%X, V%X", XY}, {"XOR V%X, V%X", XY},
+      {"ADD V%X, V%X", XY}, {"SUB V%X, V%X", XY}, {"SHR V%X", X}, {"SUBN V%X, V%X", XY},
+      {"SHL V%X", X},
+      {"SNE V%X, V%X", XY}, {"LD I, %03X", NNN}, {"JP V0, %03X", NNN}, {"RND V%X, %02X", XNN},
+      {"DRW V%X, V%X, %X", XYN}, {"SKP V%X", X}, {"SKNP V%X", X},
+      {"LD V%X, DT", X}, {"LD V%X, K", X}, {"LD DT, V%X", X}, {"LD ST, V%X", X},
+      {"ADD I, V%X", X}, {"LD F, V%X", X}, {"LD HF, V%X", X}, {"LD B, V%X", X},
+      {"LD [I], V%X", X}, {"LD V%X, [I]", X}, {"LD R, V%X", X}, {"LD V%X, R", X},
+      {"DW %04X", RAW}
+    };
+
+    /**
+     *  Maps every 16-bit opcode to its OPCODES value.
+     */
+    struct OpcodeTable
+    {
+      unsigned char entries[0x10000];
+
+      OpcodeTable()
+      {
+        for (int opcode = 0; opcode < 0x10000; opcode++)
+          entries[opcode] = decode_opcode(opcode);
+      }
+    };
+  }
+
+  /**
+   *  Decodes an opcode the same way CPU::execute does.
+   */
+  OPCODES decode_opcode(unsigned short opcode)
+  {
+    switch (opcode & 0xF000)
+    {
+      case 0x0000:
+        if ((opcode & 0x00F0) == 0xC0)
+          return OP_00CN;
+
+        switch (opcode & 0x00FF)
+        {
+          case 0xE0: return OP_00E0;
+          case 0xEE: return OP_00EE;
+          case 0xFB: return OP_00FB;
+          case 0xFC: return OP_00FC;
+          case 0xFD: return OP_00FD;
+          case 0xFE: return OP_00FE;
+          case 0xFF: return OP_00FF;
+        }
+        return OP_0NNN;
+      case 0x1000: return OP_1NNN;
+      case 0x2000: return OP_2NNN;
+      case 0x3000: return OP_3XNN;
+      case 0x4000: return OP_4XNN;
+      case 0x5000: return OP_5XY0;
+      case 0x6000: return OP_6XNN;
+      case 0x7000: return OP_7XNN;
+      case 0x8000:
+        switch (opcode & 0x000F)
+        {
+          case 0x0: return OP_8XY0;
+          case 0x1: return OP_8XY1;
+          case 0x2: return OP_8XY2;
+          case 0x3: return OP_8XY3;
+          case 0x4: return OP_8XY4;
+          case 0x5: return OP_8XY5;
+          case 0x6: return OP_8XY6;
+          case 0x7: return OP_8XY7;
+          case 0xE: return OP_8XYE;
+        }
+        return OP_UNKNOWN;
+      case 0x9000: return OP_9XY0;
+      case 0xA000: return OP_ANNN;
+      case 0xB000: return OP_BNNN;
+      case 0xC000: return OP_CXNN;
+      case 0xD000: return OP_DXYN;
+      case 0xE000:
+        if ((opcode & 0x00FF) == 0x9E)
+          return OP_EX9E;
+        else if ((opcode & 0x00FF) == 0xA1)
+          return OP_EXA1;
+        return OP_UNKNOWN;
+      case 0xF000:
+        switch (opcode & 0x00FF)
+        {
+          case 0x07: return OP_FX07;
+          case 0x0A: return OP_FX0A;
+          case 0x15: return OP_FX15;
+          case 0x18: return OP_FX18;
+          case 0x1E: return OP_FX1E;
+          case 0x29: return OP_FX29;
+          case 0x30: return OP_FX30;
+          case 0x33: return OP_FX33;
+          case 0x55: return OP_FX55;
+          case 0x65: return OP_FX65;
+          case 0x75: return OP_FX75;
+          case 0x85: return OP_FX85;
+        }
+        return OP_UNKNOWN;
+    }
+
+    return OP_UNKNOWN;
+  }
+
+  /**
+   *  Writes the assembly mnemonic of opcode to text and returns text.
+   */
+  char* disassemble(unsigned short opcode, char* text, int size)
+  {
+    const Mnemonic& mnemonic = mnemonics[decode_opcode(opcode)];
+    int x = (opcode & 0x0F00) >> 8;
+    int y = (opcode & 0x00F0) >> 4;
+
+    switch (mnemonic.operands)
+    {
+      case NONE:
+        snprintf(text, size, "%s", mnemonic.format);
+        break;
+      case N:
+        snprintf(text, size, mnemonic.format, opcode & 0x000F);
+        break;
+      case NNN:
+        snprintf(text, size, mnemonic.format, opcode & 0x0FFF);
+        break;
+      case X:
+        snprintf(text, size, mnemonic.format, x);
+        break;
+      case XNN:
+        snprintf(text, size, mnemonic.format, x, opcode & 0x00FF);
+        break;
+      case XY:
+        snprintf(text, size, mnemonic.format, x, y);
+        break;
+      case XYN:
+        snprintf(text, size, mnemonic.format, x, y, opcode & 0x000F);
+        break;
+      case RAW:
+        snprintf(text, size, mnemonic.format, opcode);
+        break;
+    }
+
+    return text;
+  }
+
+  /**
+   *  Returns the name of an instruction, such as "8XY4".
+   */
+  const char* opcode_name(OPCODES instruction)
+  {
+    return names[instruction];
+  }
+
+  /**
+   *  Returns a 64K table indexed by opcode holding the decoded OPCODES value.
+   */
+  const unsigned char* opcode_table()
+  {
+    static const OpcodeTable table;
+    return table.entries;
+  }
+}
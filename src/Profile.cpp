@@ -0,0 +1,238 @@
+#include <algorithm>
+#include <cstring>
+
+#include "../include/Profile.h"
+
+namespace YACE
+{
+  namespace
+  {
+    /**
+     *  Orders indices by descending count.
+     */
+    struct ByCount
+    {
+      const unsigned long long* counts;
+
+      bool operator()(int a, int b) const
+      {
+        return counts[a] != counts[b] ? counts[a] > counts[b] : a < b;
+      }
+    };
+
+    /**
+     *  Orders sequences by descending count.
+     */
+    bool by_sequence_count(const std::pair<unsigned int, unsigned long long>& a,
+                           const std::pair<unsigned int, unsigned long long>& b)
+    {
+      return a.second != b.second ? a.second > b.second : a.first < b.first;
+    }
+
+    double percent(unsigned long long count, unsigned long long total)
+    {
+      return total ? 100.0 * count / total : 0.0;
+    }
+
+    /**
+     *  Sequences are keyed by their length in the top byte and their
+     *  OPCODES values, the first highest.
+     */
+    unsigned int sequence_key(int length, unsigned int instructions)
+    {
+      return (length << 24) | instructions;
+    }
+  }
+
+  Profile::Profile()
+  {
+    clear();
+  }
+
+  /*
+   *  Private methods
+   */
+  /**
+   *  Enters the subroutine at address from the current frame.
+   */
+  void Profile::call(unsigned int address, unsigned int depth)
+  {
+    unsigned long long key = ((unsigned long long)frame << 12) | (address & 0xFFF);
+    std::map<unsigned long long, int>::iterator child = children.find(key);
+
+    if (child != children.end())
+    {
+      frame = child->second;
+      return;
+    }
+
+    Frame entered = {address & 0xFFF, depth, frame, 0};
+    frames.push_back(entered);
+    frame = frames.size() - 1;
+    children[key] = frame;
+  }
+
+  /**
+   *  Extends the run of instructions at consecutive addresses and counts
+   *  the sequences it ends with.
+   */
+  void Profile::count_sequence(OPCODES instruction, unsigned int address)
+  {
+    if (run_length && (address & 0xFFF) == ((last_address + 2) & 0xFFF))
+      run_length++;
+    else
+      run_length = 1;
+
+    run = (run << 8) | instruction;
+    last_address = address;
+
+    if (run_length >= 2)
+      sequences[sequence_key(2, run & 0xFFFF)]++;
+    if (run_length >= 3)
+      sequences[sequence_key(3, run & 0xFFFFFF)]++;
+  }
+
+  /**
+   *  Writes the call stack leading to frame, outermost first.
+   */
+  void Profile::write_stack(FILE* output, int frame) const
+  {
+    if (frame == 0)
+    {
+      fprintf(output, "main");
+      return;
+    }
+
+    write_stack(output, frames[frame].parent);
+    fprintf(output, ";sub_%.3X", frames[frame].address);
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Discards everything counted so far.
+   */
+  void Profile::clear()
+  {
+    using std::memset;
+
+    cycles = 0;
+    memset(opcodes, 0, sizeof(opcodes));
+    memset(addresses, 0, sizeof(addresses));
+    memset(last_opcode, 0, sizeof(last_opcode));
+    key_wait_cycles = 0;
+    draws = 0;
+    collisions = 0;
+
+    Frame root = {0, 0, -1, 0};
+    frames.assign(1, root);
+    children.clear();
+    frame = 0;
+    depth = 0;
+
+    sequences.clear();
+    last_address = 0;
+    run = 0;
+    run_length = 0;
+  }
+
+  unsigned long long Profile::get_sequence_count(OPCODES first, OPCODES second) const
+  {
+    std::map<unsigned int, unsigned long long>::const_iterator sequence =
+      sequences.find(sequence_key(2, (first << 8) | second));
+
+    return sequence != sequences.end() ? sequence->second : 0;
+  }
+
+  unsigned long long Profile::get_sequence_count(OPCODES first, OPCODES second, OPCODES third) const
+  {
+    std::map<unsigned int, unsigned long long>::const_iterator sequence =
+      sequences.find(sequence_key(3, (first << 16) | (second << 8) | third));
+
+    return sequence != sequences.end() ? sequence->second : 0;
+  }
+
+  /**
+   *  Writes a text report of the counters, with instructions, sequences
+   *  and addresses sorted by count. Only the most frequent sequences are
+   *  listed.
+   */
+  void Profile::write_flat(FILE* output) const
+  {
+    fprintf(output, "Cycles: %llu\n", cycles);
+    fprintf(output, "Key wait cycles (FX0A): %llu (%.2f%%)\n", key_wait_cycles, percent(key_wait_cycles, cycles));
+    fprintf(output, "Draws (DXYN): %llu, collisions: %llu (%.2f%%)\n\n", draws, collisions, percent(collisions, draws));
+
+    std::vector<int> order;
+    ByCount by_opcode = {opcodes};
+
+    for (int instruction = 0; instruction < OPCODE_COUNT; instruction++)
+      if (opcodes[instruction])
+        order.push_back(instruction);
+    std::sort(order.begin(), order.end(), by_opcode);
+
+    fprintf(output, "Instruction          Count  Percent\n");
+    for (size_t i = 0; i < order.size(); i++)
+      fprintf(output, "%-11s %14llu  %6.2f%%\n", opcode_name(OPCODES(order[i])),
+              opcodes[order[i]], percent(opcodes[order[i]], cycles));
+
+    std::vector<std::pair<unsigned int, unsigned long long> > frequent(sequences.begin(), sequences.end());
+    std::sort(frequent.begin(), frequent.end(), by_sequence_count);
+    if (frequent.size() > MAX_SEQUENCES_LISTED)
+      frequent.resize(MAX_SEQUENCES_LISTED);
+
+    fprintf(output, "\nSequence                         Count  Percent\n");
+    for (size_t i = 0; i < frequent.size(); i++)
+    {
+      char sequence[32] = "";
+      int length = frequent[i].first >> 24;
+
+      for (int j = length - 1; j >= 0; j--)
+      {
+        size_t used = std::strlen(sequence);
+        snprintf(sequence + used, sizeof(sequence) - used, "%s%s", used ? " " : "",
+                 opcode_name(OPCODES((frequent[i].first >> (j * 8)) & 0xFF)));
+      }
+
+      // Percent of cycles spent in the sequence
+      fprintf(output, "%-23s %14llu  %6.2f%%\n", sequence, frequent[i].second,
+              percent(frequent[i].second * length, cycles));
+    }
+
+    order.clear();
+    ByCount by_address = {addresses};
+
+    for (int address = 0; address < 0x1000; address++)
+      if (addresses[address])
+        order.push_back(address);
+    std::sort(order.begin(), order.end(), by_address);
+
+    fprintf(output, "\nAddress  Opcode  Mnemonic                     Count  Percent\n");
+    for (size_t i = 0; i < order.size(); i++)
+    {
+      char mnemonic[32];
+      unsigned short opcode = last_opcode[order[i]];
+
+      fprintf(output, "%.3X      %.4X    %-18s %14llu  %6.2f%%\n", order[i], opcode,
+              disassemble(opcode, mnemonic, sizeof(mnemonic)),
+              addresses[order[i]], percent(addresses[order[i]], cycles));
+    }
+  }
+
+  /**
+   *  Writes one "main;sub_XXX;... cycles" line per call stack, the folded
+   *  format read by flame graph tools.
+   */
+  void Profile::write_folded(FILE* output) const
+  {
+    for (size_t i = 0; i < frames.size(); i++)
+    {
+      if (!frames[i].cycles)
+        continue;
+
+      write_stack(output, i);
+      fprintf(output, " %llu\n", frames[i].cycles);
+    }
+  }
+}
@@ -0,0 +1,169 @@
+#include <cstring>
+
+#include "../include/Recompiled.h"
+
+namespace YACE
+{
+  Recompiled::Recompiled() : program(0), resolved(false), quirks(QUIRKS_DEFAULT)
+  {
+  }
+
+  /**
+   *  The program is looked up again for the copied memory, so a copy
+   *  starts out unresolved.
+   */
+  Recompiled::Recompiled(const Recompiled& other) : program(0), resolved(false), quirks(other.quirks)
+  {
+  }
+
+  Recompiled& Recompiled::operator=(const Recompiled& other)
+  {
+    quirks = other.quirks;
+    flush();
+    return *this;
+  }
+
+  /*
+   *  Private methods
+   */
+  /**
+   *  Registered programs. Programs are added while static objects are
+   *  constructed and only read afterwards.
+   */
+  std::vector<const RecompiledProgram*>& Recompiled::programs()
+  {
+    static std::vector<const RecompiledProgram*> registered;
+    return registered;
+  }
+
+  /**
+   *  Picks the program for the game loaded at 0x200 and indexes its
+   *  blocks.
+   */
+  void Recompiled::resolve(const unsigned char* memory)
+  {
+    const std::vector<const RecompiledProgram*>& registered = programs();
+
+    resolved = true;
+    program = 0;
+
+    for (size_t i = 0; i < registered.size() && !program; i++)
+    {
+      const RecompiledProgram* candidate = registered[i];
+
+      if (candidate->quirks == quirks && candidate->length <= 0xE00 &&
+          !std::memcmp(memory + 0x200, candidate->image, candidate->length))
+        program = candidate;
+    }
+
+    if (!program)
+      return;
+
+    index.assign(0x1000, -1);
+    states.assign(program->block_count, BLOCK_UNCHECKED);
+
+    for (int block = 0; block < program->block_count; block++)
+      index[program->blocks[block].start & 0xFFF] = block;
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Makes a generated program available to every CPU. Returns true so
+   *  generated code can call it from a static initializer.
+   */
+  bool Recompiled::add(const RecompiledProgram* program)
+  {
+    programs().push_back(program);
+    return true;
+  }
+
+  /**
+   *  Forgets the program, it's looked up again when the next block is
+   *  requested.
+   */
+  void Recompiled::flush()
+  {
+    program = 0;
+    resolved = false;
+  }
+
+  /**
+   *  Returns the translated block starting at address, or 0 if there is
+   *  none or its memory has changed.
+   */
+  const JIT::Block* Recompiled::get_block(const unsigned char* memory, unsigned int address)
+  {
+    if (!resolved)
+      resolve(memory);
+
+    if (!program || address > 0xFFF || index[address] < 0)
+      return 0;
+
+    int block = index[address];
+
+    if (states[block] == BLOCK_UNCHECKED)
+    {
+      const JIT::Block& code = program->blocks[block];
+      const unsigned char* original = program->image + (code.start - 0x200);
+
+      states[block] = std::memcmp(memory + code.start, original, code.end - code.start) ? BLOCK_STALE : BLOCK_VALID;
+    }
+
+    return states[block] == BLOCK_VALID ? &program->blocks[block] : 0;
+  }
+
+  /**
+   *  Checks every block affected by a write to memory against its
+   *  original again before it's used.
+   */
+  void Recompiled::invalidate(unsigned int address, unsigned int length)
+  {
+    if (!resolved)
+      return;
+
+    // Writes over the entry point load a new game
+    if (address <= 0x200 && address + length > 0x200)
+    {
+      flush();
+      return;
+    }
+
+    if (!program)
+      return;
+
+    // Each part of the write up to the end of memory
+    for (unsigned int i = address; i < address + length; )
+    {
+      unsigned int written = i & 0xFFF;
+      unsigned int end = written + (address + length - i);
+      unsigned int first = written > MAX_BLOCK_LENGTH * 2 ? written - MAX_BLOCK_LENGTH * 2 : 0;
+
+      if (end > 0x1000)
+        end = 0x1000;
+
+      for (unsigned int start = first; start < end; start++)
+      {
+        int block = index[start];
+
+        if (block >= 0 && program->blocks[block].end > written)
+          states[block] = BLOCK_UNCHECKED;
+      }
+
+      i += end - written;
+    }
+  }
+
+  /**
+   *  Programs are translated for one quirk profile, so changing it looks
+   *  the program up again.
+   */
+  void Recompiled::set_quirks(QUIRK_PROFILES quirks)
+  {
+    if (quirks != this->quirks)
+      flush();
+
+    this->quirks = quirks;
+  }
+}
@@ -0,0 +1,209 @@
+#include <cstring>
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+#include "../include/Renderer.h"
+
+namespace YACE
+{
+  namespace
+  {
+#if defined(__x86_64__)
+    /**
+     *  Every bit selects the off or on color through a mask made by
+     *  comparing the broadcast byte with one bit per lane.
+     */
+    void expand_rgba32_sse2(const unsigned char* bits, int count, void* destination, const unsigned int* palette)
+    {
+      __m128i* pixels = (__m128i*)destination;
+      const __m128i off = _mm_set1_epi32(palette[0]);
+      const __m128i on = _mm_set1_epi32(palette[1]);
+      const __m128i high = _mm_setr_epi32(0x80, 0x40, 0x20, 0x10);
+      const __m128i low = _mm_setr_epi32(0x08, 0x04, 0x02, 0x01);
+
+      for (int i = 0; i < count; i++)
+      {
+        __m128i byte = _mm_set1_epi32(bits[i]);
+        __m128i first = _mm_cmpeq_epi32(_mm_and_si128(byte, high), high);
+        __m128i second = _mm_cmpeq_epi32(_mm_and_si128(byte, low), low);
+
+        _mm_storeu_si128(pixels++, _mm_or_si128(_mm_and_si128(first, on), _mm_andnot_si128(first, off)));
+        _mm_storeu_si128(pixels++, _mm_or_si128(_mm_and_si128(second, on), _mm_andnot_si128(second, off)));
+      }
+    }
+
+    void expand_rgb565_sse2(const unsigned char* bits, int count, void* destination, const unsigned int* palette)
+    {
+      __m128i* pixels = (__m128i*)destination;
+      const __m128i off = _mm_set1_epi16(palette[0]);
+      const __m128i on = _mm_set1_epi16(palette[1]);
+      const __m128i lanes = _mm_setr_epi16(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+      for (int i = 0; i < count; i++)
+      {
+        __m128i mask = _mm_cmpeq_epi16(_mm_and_si128(_mm_set1_epi16(bits[i]), lanes), lanes);
+        _mm_storeu_si128(pixels++, _mm_or_si128(_mm_and_si128(mask, on), _mm_andnot_si128(mask, off)));
+      }
+    }
+
+    __attribute__((target("avx2")))
+    void expand_rgba32_avx2(const unsigned char* bits, int count, void* destination, const unsigned int* palette)
+    {
+      __m256i* pixels = (__m256i*)destination;
+      const __m256i off = _mm256_set1_epi32(palette[0]);
+      const __m256i on = _mm256_set1_epi32(palette[1]);
+      const __m256i lanes = _mm256_setr_epi32(0x80, 0x40, 0x20, 0x10, 0x08, 0x04, 0x02, 0x01);
+
+      for (int i = 0; i < count; i++)
+      {
+        __m256i mask = _mm256_cmpeq_epi32(_mm256_and_si256(_mm256_set1_epi32(bits[i]), lanes), lanes);
+        _mm256_storeu_si256(pixels++, _mm256_blendv_epi8(off, on, mask));
+      }
+    }
+
+    /**
+     *  Takes two bytes at a time, count is always even.
+     */
+    __attribute__((target("avx2")))
+    void expand_rgb565_avx2(const unsigned char* bits, int count, void* destination, const unsigned int* palette)
+    {
+      __m256i* pixels = (__m256i*)destination;
+      const __m256i off = _mm256_set1_epi16(palette[0]);
+      const __m256i on = _mm256_set1_epi16(palette[1]);
+      const __m256i lanes = _mm256_setr_epi16(short(0x8000), 0x4000, 0x2000, 0x1000, 0x0800, 0x0400, 0x0200, 0x0100,
+                                              0x0080, 0x0040, 0x0020, 0x0010, 0x0008, 0x0004, 0x0002, 0x0001);
+
+      for (int i = 0; i < count; i += 2)
+      {
+        __m256i word = _mm256_set1_epi16((bits[i] << 8) | bits[i + 1]);
+        __m256i mask = _mm256_cmpeq_epi16(_mm256_and_si256(word, lanes), lanes);
+        _mm256_storeu_si256(pixels++, _mm256_blendv_epi8(off, on, mask));
+      }
+    }
+#else
+    void expand_rgba32(const unsigned char* bits, int count, void* destination, const unsigned int* palette)
+    {
+      unsigned int* pixels = (unsigned int*)destination;
+
+      for (int i = 0; i < count; i++)
+        for (int bit = 7; bit >= 0; bit--)
+          *(pixels++) = palette[(bits[i] >> bit) & 1];
+    }
+
+    void expand_rgb565(const unsigned char* bits, int count, void* destination, const unsigned int* palette)
+    {
+      unsigned short* pixels = (unsigned short*)destination;
+
+      for (int i = 0; i < count; i++)
+        for (int bit = 7; bit >= 0; bit--)
+          *(pixels++) = palette[(bits[i] >> bit) & 1];
+    }
+#endif
+  }
+
+  Renderer::Renderer() : expand(0)
+  {
+    set_format(RGBA32);
+    set_scale(1);
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Renders the rows set in rows, bit y for row y of the screen, to
+   *  destination. Each takes scale lines of pitch bytes starting at line
+   *  y * scale, so destination must hold video.get_height() * scale lines
+   *  of at least video.get_width() * scale pixels.
+   */
+  void Renderer::render(const Framebuffer& video, void* destination, int pitch, unsigned long long rows) const
+  {
+    const Framebuffer::Row* screen = video.get_rows();
+    int width = video.get_width();
+    int height = video.get_height();
+    int line_size = width * scale * get_pixel_size();
+    unsigned char bits[128 * MAX_SCALE / 8];  // One scaled line, 1 bit per pixel
+
+    if (height < 64)
+      rows &= (1ULL << height) - 1;
+
+    while (rows)
+    {
+      int y = __builtin_ctzll(rows);
+      unsigned char* line = (unsigned char*)destination + y * scale * pitch;
+      int count = 0;
+
+      rows &= rows - 1;
+
+      for (int x = 0; x < width; x += 8)
+      {
+        unsigned long long spread_bits = spread[(unsigned char)(screen[y] >> (120 - x))];
+
+        for (int shift = (scale - 1) * 8; shift >= 0; shift -= 8)
+          bits[count++] = spread_bits >> shift;
+      }
+
+      expand(bits, count, line, palette);
+
+      for (int copy = 1; copy < scale; copy++)
+        std::memcpy(line + copy * pitch, line, line_size);
+    }
+  }
+
+  /**
+   *  Selects the pixel format and resets the palette to black and white
+   *  in it.
+   */
+  void Renderer::set_format(FORMATS format)
+  {
+    if (format != RGBA32 && format != RGB565)
+      throw "Invalid pixel format!";
+
+    this->format = format;
+
+    if (format == RGBA32)
+      set_palette(0x000000FF, 0xFFFFFFFF);
+    else
+      set_palette(0x0000, 0xFFFF);
+
+#if defined(__x86_64__)
+    __builtin_cpu_init();
+    bool avx2 = __builtin_cpu_supports("avx2");
+
+    if (format == RGBA32)
+      expand = avx2 ? expand_rgba32_avx2 : expand_rgba32_sse2;
+    else
+      expand = avx2 ? expand_rgb565_avx2 : expand_rgb565_sse2;
+#else
+    expand = format == RGBA32 ? expand_rgba32 : expand_rgb565;
+#endif
+  }
+
+  /**
+   *  Sets the colors of unlit and lit pixels, in the current pixel format.
+   */
+  void Renderer::set_palette(unsigned int off, unsigned int on)
+  {
+    palette[0] = off;
+    palette[1] = on;
+  }
+
+  void Renderer::set_scale(int scale)
+  {
+    if (scale < 1 || scale > MAX_SCALE)
+      throw "Invalid scale!";
+
+    this->scale = scale;
+
+    for (int byte = 0; byte < 256; byte++)
+    {
+      spread[byte] = 0;
+
+      for (int bit = 0; bit < 8; bit++)
+        if (byte & (1 << bit))
+          spread[byte] |= ((1ULL << scale) - 1) << (bit * scale);
+    }
+  }
+}
@@ -0,0 +1,284 @@
+#include <cstring>
+
+#include "../include/Chip8.h"
+#include "../include/Rewind.h"
+
+namespace YACE
+{
+  namespace
+  {
+    const unsigned int STATE_SIZE = sizeof(SaveState);
+
+    // Equal bytes that end a literal run, shorter gaps are copied
+    const unsigned int MIN_GAP = 4;
+
+    const unsigned char zero_state[STATE_SIZE] = {0};
+
+    /**
+     *  Writes state XOR base as runs of a 16-bit count of zero bytes to
+     *  skip, a 16-bit length and length literal bytes. Returns the encoded
+     *  size, at most 2 * STATE_SIZE.
+     */
+    unsigned int encode(const unsigned char* state, const unsigned char* base, unsigned char* output)
+    {
+      unsigned int size = 0;
+      unsigned int position = 0;
+
+      while (position < STATE_SIZE)
+      {
+        unsigned int start = position;
+
+        // Skip equal words, then equal bytes
+        for (unsigned long long a, b; position + 8 <= STATE_SIZE; position += 8)
+        {
+          std::memcpy(&a, state + position, 8);
+          std::memcpy(&b, base + position, 8);
+          if (a != b)
+            break;
+        }
+        while (position < STATE_SIZE && state[position] == base[position])
+          position++;
+
+        if (position == STATE_SIZE)
+          break;
+
+        // Extend the literal until MIN_GAP equal bytes follow it
+        unsigned int literal = position;
+        unsigned int end = position + 1;
+
+        for (position++; position < STATE_SIZE && position - end < MIN_GAP; position++)
+          if (state[position] != base[position])
+            end = position + 1;
+
+        unsigned int skip = literal - start;
+        unsigned int length = end - literal;
+
+        output[size++] = skip & 0xFF;
+        output[size++] = skip >> 8;
+        output[size++] = length & 0xFF;
+        output[size++] = length >> 8;
+
+        for (unsigned int i = literal; i < end; i++)
+          output[size++] = state[i] ^ base[i];
+
+        position = end;
+      }
+
+      return size;
+    }
+
+    /**
+     *  XORs an encoded snapshot into state.
+     */
+    void apply(const unsigned char* input, unsigned int size, unsigned char* state)
+    {
+      unsigned int position = 0;
+
+      for (unsigned int i = 0; i < size; )
+      {
+        position += input[i] | (input[i + 1] << 8);
+        unsigned int length = input[i + 2] | (input[i + 3] << 8);
+        i += 4;
+
+        for (unsigned int end = i + length; i < end; i++)
+          state[position++] ^= input[i];
+      }
+    }
+  }
+
+  /**
+   *  Budget is the size in bytes of the buffer holding the encoded
+   *  snapshots. Every keyframe_interval snapshots a keyframe is taken.
+   */
+  Rewind::Rewind(unsigned int budget, int keyframe_interval) : budget(budget), keyframe_interval(keyframe_interval)
+  {
+    data = new unsigned char[budget];
+    scratch = new unsigned char[2 * STATE_SIZE];
+    clear();
+  }
+
+  Rewind::~Rewind()
+  {
+    delete[] data;
+    delete[] scratch;
+  }
+
+  /*
+   *  Private methods
+   */
+  /**
+   *  Returns the offset for a snapshot of size bytes, dropping the oldest
+   *  snapshots in the way. The free space starts at head and ends at the
+   *  oldest snapshot.
+   */
+  unsigned int Rewind::allocate(unsigned int size)
+  {
+    if (size > budget)
+      throw "Rewind budget too small!";
+
+    unsigned int offset = head;
+
+    if (offset + size > budget)
+    {
+      // Snapshots between head and the end are the oldest
+      while (!entries.empty() && entries.front().offset >= head)
+        drop_oldest();
+      offset = 0;
+    }
+
+    while (!entries.empty() && entries.front().offset >= offset && entries.front().offset < offset + size)
+      drop_oldest();
+
+    return offset;
+  }
+
+  void Rewind::decode(const Entry& entry, SaveState& state) const
+  {
+    unsigned char* bytes = (unsigned char*)&state;
+
+    if (has_key && entry.key_sequence == key_sequence)
+      state = key;
+    else
+    {
+      const Entry& keyframe = entries[entry.key_sequence - entries.front().sequence];
+
+      std::memset(bytes, 0, STATE_SIZE);
+      apply(data + keyframe.offset, keyframe.size, bytes);
+    }
+
+    if (entry.sequence != entry.key_sequence)
+      apply(data + entry.offset, entry.size, bytes);
+  }
+
+  /**
+   *  Drops the oldest keyframe and the snapshots encoded against it.
+   */
+  void Rewind::drop_oldest()
+  {
+    do
+    {
+      used -= entries.front().size;
+      entries.pop_front();
+    }
+    while (!entries.empty() && entries.front().sequence != entries.front().key_sequence);
+
+    if (entries.empty() || entries.front().sequence > key_sequence)
+      has_key = false;
+  }
+
+  /*
+   *  Public methods
+   */
+  void Rewind::clear()
+  {
+    entries.clear();
+    head = 0;
+    used = 0;
+    next_sequence = 0;
+    has_key = false;
+    key_sequence = 0;
+    since_key = 0;
+  }
+
+  /**
+   *  Appends a snapshot of chip8.
+   */
+  void Rewind::push(Chip8& chip8)
+  {
+    SaveState state;
+    chip8.save_state(state);
+
+    const unsigned char* bytes = (const unsigned char*)&state;
+    bool keyframe = !has_key || since_key >= keyframe_interval;
+    unsigned int size = 0;
+    unsigned int offset = 0;
+
+    if (!keyframe)
+    {
+      size = encode(bytes, (const unsigned char*)&key, scratch);
+
+      // Deltas larger than half a state aren't worth keeping the
+      // keyframe for
+      keyframe = size > STATE_SIZE / 2;
+      if (!keyframe)
+      {
+        offset = allocate(size);
+        keyframe = !has_key;
+      }
+    }
+
+    if (keyframe)
+    {
+      size = encode(bytes, zero_state, scratch);
+      offset = allocate(size);
+    }
+
+    Entry entry = {next_sequence, keyframe ? next_sequence : key_sequence, chip8.get_cycles(), offset, size};
+    std::memcpy(data + offset, scratch, size);
+    entries.push_back(entry);
+    head = offset + size;
+    used += size;
+    next_sequence++;
+
+    if (keyframe)
+    {
+      key = state;
+      key_sequence = entry.sequence;
+      has_key = true;
+      since_key = 0;
+    }
+
+    since_key++;
+  }
+
+  /**
+   *  Loads the snapshot pushed age snapshots before the newest into
+   *  chip8, keeping the history. Returns false if there is no such
+   *  snapshot.
+   */
+  bool Rewind::restore(Chip8& chip8, int age)
+  {
+    if (age < 0 || age >= (int)entries.size())
+      return false;
+
+    SaveState state;
+    decode(entries[entries.size() - 1 - age], state);
+    chip8.restore_state(state);
+
+    return true;
+  }
+
+  /**
+   *  Like restore, but also drops the newer snapshots so the history
+   *  continues from the restored one.
+   */
+  bool Rewind::rewind(Chip8& chip8, int age)
+  {
+    if (!restore(chip8, age))
+      return false;
+
+    for (int i = 0; i < age; i++)
+    {
+      used -= entries.back().size;
+      entries.pop_back();
+    }
+
+    const Entry& newest = entries.back();
+
+    head = newest.offset + newest.size;
+    next_sequence = newest.sequence + 1;
+
+    if (newest.key_sequence != key_sequence || !has_key)
+    {
+      const Entry& keyframe = entries[newest.key_sequence - entries.front().sequence];
+
+      has_key = false;
+      decode(keyframe, key);
+      key_sequence = keyframe.sequence;
+      has_key = true;
+    }
+    since_key = newest.sequence - key_sequence + 1;
+
+    return true;
+  }
+}
@@ -0,0 +1,150 @@
+#include <cstdio>
+#include <cstring>
+
+#include "../include/RomCache.h"
+
+namespace YACE
+{
+  namespace
+  {
+    const int MAX_LENGTH = 0xE00;     // Memory from 0x200 to the end
+
+    void delete_data(Rom* rom)
+    {
+      delete[] rom->data;
+      delete rom;
+    }
+
+    /**
+     *  Reads up to MAX_LENGTH bytes of file into a Rom. The bytes are
+     *  copied so later changes to the file can't alter a cached Rom.
+     */
+    std::shared_ptr<const Rom> read_rom(const char* file)
+    {
+      FILE* input = fopen(file, "rb");
+      if (!input)
+        throw "Couldn't open specified file!";
+
+      unsigned char* data = new unsigned char[MAX_LENGTH];
+      int length = fread(data, 1, MAX_LENGTH, input);
+      bool failed = ferror(input);
+      fclose(input);
+
+      if (failed)
+      {
+        delete[] data;
+        throw "Couldn't read specified file!";
+      }
+
+      Rom read = {RomCache::hash(data, length), data, length};
+      return std::shared_ptr<const Rom>(new Rom(read), delete_data);
+    }
+  }
+
+  std::mutex RomCache::mutex;
+  std::map<unsigned long long, std::shared_ptr<const Rom> > RomCache::roms;
+  std::map<std::string, std::shared_ptr<const Rom> > RomCache::files;
+
+  /*
+   *  Private methods
+   */
+  /**
+   *  Returns the cached Rom with the same contents as rom, caching rom if
+   *  there is none. The caller holds mutex.
+   */
+  std::shared_ptr<const Rom> RomCache::insert(const std::shared_ptr<const Rom>& rom)
+  {
+    std::map<unsigned long long, std::shared_ptr<const Rom> >::iterator cached = roms.find(rom->hash);
+
+    if (cached == roms.end())
+    {
+      roms[rom->hash] = rom;
+      return rom;
+    }
+
+    const Rom& other = *cached->second;
+    if (other.length == rom->length && !std::memcmp(other.data, rom->data, rom->length))
+      return cached->second;
+
+    // Hash collision, leave the first one cached
+    return rom;
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Drops the cache's references to every Rom. Roms still in use stay
+   *  valid until released.
+   */
+  void RomCache::clear()
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+
+    roms.clear();
+    files.clear();
+  }
+
+  /**
+   *  Returns the 64-bit FNV-1a hash of a game, as stored in Rom.
+   */
+  unsigned long long RomCache::hash(const unsigned char* data, int length)
+  {
+    unsigned long long hash = 0xCBF29CE484222325ULL;
+
+    for (int i = 0; i < length; i++)
+      hash = (hash ^ data[i]) * 0x100000001B3ULL;
+
+    return hash;
+  }
+
+  /**
+   *  Returns the contents of file, reading it only the first time the
+   *  path is loaded.
+   */
+  std::shared_ptr<const Rom> RomCache::load(const char* file)
+  {
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+
+      std::map<std::string, std::shared_ptr<const Rom> >::iterator cached = files.find(file);
+      if (cached != files.end())
+        return cached->second;
+    }
+
+    // Read without holding the lock, another thread may read the same file
+    std::shared_ptr<const Rom> rom = read_rom(file);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    rom = insert(rom);
+    files[file] = rom;
+    return rom;
+  }
+
+  /**
+   *  Returns a cached copy of a game already in memory.
+   */
+  std::shared_ptr<const Rom> RomCache::load(const unsigned char* data, int length)
+  {
+    if (length > MAX_LENGTH)
+      length = MAX_LENGTH;
+    if (length < 0)
+      length = 0;
+
+    unsigned long long hash = RomCache::hash(data, length);
+
+    std::lock_guard<std::mutex> lock(mutex);
+
+    std::map<unsigned long long, std::shared_ptr<const Rom> >::iterator cached = roms.find(hash);
+    if (cached != roms.end() && cached->second->length == length &&
+        !std::memcmp(cached->second->data, data, length))
+      return cached->second;
+
+    unsigned char* copy = new unsigned char[length + 1];
+    std::memcpy(copy, data, length);
+
+    Rom copied = {hash, copy, length};
+    return insert(std::shared_ptr<const Rom>(new Rom(copied), delete_data));
+  }
+}
@@ -0,0 +1,81 @@
+#include <cstdio>
+#include <cstring>
+
+#include "../include/Trace.h"
+
+namespace YACE
+{
+  /**
+   *  Capacity is rounded up to a power of two.
+   */
+  Trace::Trace(int capacity) : count(0)
+  {
+    unsigned int size = 1;
+    while (size < (unsigned int)capacity)
+      size <<= 1;
+
+    records = new TraceRecord[size];
+    std::memset(records, 0, sizeof(TraceRecord) * size);
+    mask = size - 1;
+  }
+
+  Trace::~Trace()
+  {
+    delete[] records;
+  }
+
+  /**
+   *  Copies up to maximum of the newest records to destination, oldest
+   *  first, and returns the number copied.
+   */
+  int Trace::read(TraceRecord* destination, int maximum) const
+  {
+    unsigned long long end = get_count();
+    unsigned long long start = end > (unsigned long long)maximum ? end - maximum : 0;
+
+    if (end - start > mask + 1)
+      start = end - (mask + 1);
+
+    for (unsigned long long index = start; index < end; index++)
+      destination[index - start] = records[index & mask];
+
+    // Drop records the writer may have replaced during the copy, including
+    // the one it may be writing now
+    std::atomic_thread_fence(std::memory_order_acquire);
+    unsigned long long written = count.load(std::memory_order_relaxed);
+    unsigned long long valid = written > mask ? written - mask : 0;
+
+    if (valid > start)
+    {
+      if (valid >= end)
+        return 0;
+
+      std::memmove(destination, destination + (valid - start), sizeof(TraceRecord) * (end - valid));
+      start = valid;
+    }
+
+    return end - start;
+  }
+
+  /**
+   *  Writes the buffered records to a file.
+   */
+  void Trace::save(const char* file) const
+  {
+    TraceRecord* copy = new TraceRecord[mask + 1];
+    TraceHeader header = {TraceHeader::MAGIC, TraceHeader::VERSION, sizeof(TraceRecord), 0};
+    header.count = read(copy, mask + 1);
+
+    FILE* output = fopen(file, "wb");
+    bool written = output && fwrite(&header, sizeof(header), 1, output) == 1 &&
+                   fwrite(copy, sizeof(TraceRecord), header.count, output) == header.count;
+
+    if (output && fclose(output) != 0)
+      written = false;
+
+    delete[] copy;
+
+    if (!written)
+      throw "Couldn't write specified file!";
+  }
+}
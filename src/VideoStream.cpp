@@ -0,0 +1,264 @@
+#if defined(__unix__)
+#include <unistd.h>
+#endif
+
+#include <cerrno>
+#include <cstring>
+
+#include "../include/VideoStream.h"
+
+namespace YACE
+{
+  namespace
+  {
+    using namespace VideoFormat;
+
+    unsigned long long read_little_endian(const unsigned char* data, int size)
+    {
+      unsigned long long value = 0;
+
+      for (int i = size - 1; i >= 0; i--)
+        value = (value << 8) | data[i];
+
+      return value;
+    }
+
+    /**
+     *  Returns the size of the packet at the start of data, or 0 if it
+     *  doesn't hold all of it yet.
+     */
+    unsigned int packet_size(const unsigned char* data, unsigned int size)
+    {
+      if (size < 1)
+        return 0;
+
+      if (data[0] & UNCHANGED)
+        return 1;
+
+      int mask_size = data[0] & SUPERCHIP ? 8 : 4;
+      int present_size = data[0] & SUPERCHIP ? 2 : 1;
+      unsigned int position = 1 + mask_size;
+
+      if (size < position)
+        return 0;
+
+      for (unsigned long long changed = read_little_endian(data + 1, mask_size); changed; changed &= changed - 1)
+      {
+        if (size < position + present_size)
+          return 0;
+
+        position += present_size + __builtin_popcount(read_little_endian(data + position, present_size));
+      }
+
+      return size < position ? 0 : position;
+    }
+  }
+
+  VideoEncoder::VideoEncoder(const Sink& sink, int keyframe_interval)
+    : sink(sink), mode(Framebuffer::CHIP8), keyframe_interval(keyframe_interval), since_key(0),
+      started(false), keyframe_requested(false), frames(0), bytes(0)
+  {
+    std::memset(rows, 0, sizeof(rows));
+  }
+
+  /*
+   *  Public methods
+   */
+  /**
+   *  Returns a sink writing to a file descriptor, such as a file, pipe or
+   *  socket. Only unix hosts have descriptors.
+   */
+  VideoEncoder::Sink VideoEncoder::descriptor_sink(int descriptor)
+  {
+#if defined(__unix__)
+    return [descriptor](const unsigned char* data, unsigned int size)
+    {
+      while (size > 0)
+      {
+        ssize_t written = write(descriptor, data, size);
+
+        if (written < 0 && errno == EINTR)
+          continue;
+        if (written <= 0)
+          throw "Couldn't write video stream!";
+
+        data += written;
+        size -= written;
+      }
+    };
+#else
+    throw "File descriptors aren't supported on this host!";
+#endif
+  }
+
+  /**
+   *  Returns a sink appending to buffer.
+   */
+  VideoEncoder::Sink VideoEncoder::memory_sink(std::vector<unsigned char>& buffer)
+  {
+    return [&buffer](const unsigned char* data, unsigned int size)
+    {
+      buffer.insert(buffer.end(), data, data + size);
+    };
+  }
+
+  /**
+   *  Sends the visible screen as the next frame.
+   */
+  void VideoEncoder::encode(const Framebuffer& video)
+  {
+    const Framebuffer::Row* screen = video.get_rows();
+    Framebuffer::MODES current = video.get_mode();
+    Framebuffer::Row visible = current == Framebuffer::SUPERCHIP ? ~Framebuffer::Row(0) : ~Framebuffer::Row(0) << 64;
+    int height = video.get_height();
+    int row_size = video.get_width() / 8;
+    unsigned int size = 0;
+
+    if (!started)
+    {
+      std::memcpy(packet, MAGIC, sizeof(MAGIC));
+      packet[sizeof(MAGIC)] = VERSION;
+      size = HEADER_SIZE;
+    }
+
+    bool keyframe = !started || keyframe_requested || current != mode ||
+                    (keyframe_interval && since_key >= keyframe_interval);
+
+    if (keyframe)
+    {
+      std::memset(rows, 0, sizeof(rows));
+      mode = current;
+      since_key = 0;
+      keyframe_requested = false;
+    }
+
+    unsigned long long changed = 0;
+
+    for (int y = 0; y < height; y++)
+      changed |= (unsigned long long)((screen[y] & visible) != rows[y]) << y;
+
+    packet[size++] = (keyframe ? KEYFRAME : 0) | (current == Framebuffer::SUPERCHIP ? SUPERCHIP : 0) |
+                     (changed ? 0 : UNCHANGED);
+
+    if (changed)
+    {
+      for (int i = 0; i < height / 8; i++)
+        packet[size++] = changed >> (i * 8);
+
+      for (unsigned long long remaining = changed; remaining; remaining &= remaining - 1)
+      {
+        int y = __builtin_ctzll(remaining);
+        Framebuffer::Row row = screen[y] & visible;
+        Framebuffer::Row delta = row ^ rows[y];
+        unsigned int present_at = size;
+        unsigned int present = 0;
+
+        size += row_size / 8;
+        rows[y] = row;
+
+        for (int i = 0; i < row_size; i++)
+        {
+          unsigned char byte = delta >> (120 - i * 8);
+
+          if (byte)
+          {
+            present |= 1 << i;
+            packet[size++] = byte;
+          }
+        }
+
+        for (int i = 0; i < row_size / 8; i++)
+          packet[present_at + i] = present >> (i * 8);
+      }
+    }
+
+    since_key++;
+
+    try
+    {
+      sink(packet, size);
+    }
+    catch (...)
+    {
+      // The client may have missed this frame
+      keyframe_requested = true;
+      throw;
+    }
+
+    started = true;
+    frames++;
+    bytes += size;
+  }
+
+  VideoDecoder::VideoDecoder() : mode(Framebuffer::CHIP8), started(false), keyed(false), frames(0)
+  {
+    std::memset(rows, 0, sizeof(rows));
+  }
+
+  /**
+   *  Decodes the next frame from data, and the stream header before the
+   *  first one, into the framebuffer. Returns the number of bytes used,
+   *  or 0 if data doesn't hold the whole frame yet.
+   */
+  unsigned int VideoDecoder::decode(const unsigned char* data, unsigned int size)
+  {
+    unsigned int position = 0;
+
+    if (!started)
+    {
+      if (size < (unsigned int)HEADER_SIZE)
+        return 0;
+
+      if (std::memcmp(data, MAGIC, sizeof(MAGIC)) || data[sizeof(MAGIC)] != VERSION)
+        throw "Invalid video stream!";
+
+      position = HEADER_SIZE;
+    }
+
+    unsigned int length = packet_size(data + position, size - position);
+    if (!length)
+      return 0;
+
+    const unsigned char* packet = data + position;
+    unsigned char flags = *(packet++);
+    Framebuffer::MODES packet_mode = flags & SUPERCHIP ? Framebuffer::SUPERCHIP : Framebuffer::CHIP8;
+
+    // Modes only change on keyframes
+    if ((flags & ~(KEYFRAME | SUPERCHIP | UNCHANGED)) || (!(flags & KEYFRAME) && (!keyed || packet_mode != mode)))
+      throw "Invalid video stream!";
+
+    if (flags & KEYFRAME)
+    {
+      std::memset(rows, 0, sizeof(rows));
+      mode = packet_mode;
+      keyed = true;
+    }
+
+    if (!(flags & UNCHANGED))
+    {
+      int mask_size = mode == Framebuffer::SUPERCHIP ? 8 : 4;
+      int present_size = mask_size / 4;
+      int row_size = present_size * 8;
+
+      unsigned long long changed = read_little_endian(packet, mask_size);
+      packet += mask_size;
+
+      for (; changed; changed &= changed - 1)
+      {
+        int y = __builtin_ctzll(changed);
+        unsigned int present = read_little_endian(packet, present_size);
+
+        packet += present_size;
+
+        for (int i = 0; i < row_size; i++)
+          if (present & (1 << i))
+            rows[y] ^= Framebuffer::Row(*(packet++)) << (120 - i * 8);
+      }
+    }
+
+    video.load(rows, mode);
+    started = true;
+    frames++;
+    return position + length;
+  }
+}
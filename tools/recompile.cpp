@@ -0,0 +1,419 @@
+/**
+ * Translates ROMs ahead of time into a C++ file of blocks for the
+ * recompiled CPU engine.
+ */
+
+#include <cstdarg>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+#include "../include/Opcodes.h"
+#include "../include/Recompiled.h"
+
+using namespace YACE;
+
+namespace
+{
+  const char* const quirk_names[QUIRK_PROFILE_COUNT] = {"default", "chip8", "superchip", "modern"};
+  const char* const quirk_enums[QUIRK_PROFILE_COUNT] = {"QUIRKS_DEFAULT", "QUIRKS_CHIP8", "QUIRKS_SUPERCHIP", "QUIRKS_MODERN"};
+
+  /**
+   *  Quirks that change translated opcodes.
+   */
+  struct Flags
+  {
+    bool shift_vy;
+    bool add_i_overflow;
+  };
+
+  template <typename Quirks>
+  Flags flags_of()
+  {
+    Flags flags = {Quirks::SHIFT_VY, Quirks::ADD_I_OVERFLOW};
+    return flags;
+  }
+
+  struct Block
+  {
+    unsigned int start;
+    unsigned int end;     // First address after the block
+    int length;           // Number of opcodes
+    std::string code;     // Body of the block function
+  };
+
+  void append(std::string& code, const char* format, ...)
+  {
+    char line[256];
+    va_list arguments;
+
+    va_start(arguments, format);
+    vsnprintf(line, sizeof(line), format, arguments);
+    va_end(arguments);
+
+    code += "    ";
+    code += line;
+    code += "\n";
+  }
+
+  /**
+   *  Ends a block with a jump to address.
+   */
+  bool jump(std::string& code, unsigned int address, std::vector<unsigned int>& exits)
+  {
+    append(code, "*program_counter = 0x%03X;", address);
+    exits.push_back(address);
+    return true;
+  }
+
+  /**
+   *  Appends the C++ for an opcode at pc, using the same semantics as the
+   *  CPU's opcode functions. Returns false if it's left to the
+   *  interpreter. Sets exits to the addresses the block may continue at if
+   *  the opcode ends it.
+   */
+  bool translate(unsigned short opcode, unsigned int pc, const Flags& flags, std::string& code,
+                 std::vector<unsigned int>& exits)
+  {
+    int x = (opcode & 0x0F00) >> 8;
+    int y = (opcode & 0x00F0) >> 4;
+    int source = flags.shift_vy ? y : x;
+    int nn = opcode & 0x00FF;
+    int nnn = opcode & 0x0FFF;
+    const char* condition = 0;
+
+    // A register minus itself is 0 and never borrows
+    if ((decode_opcode(opcode) == OP_8XY5 || decode_opcode(opcode) == OP_8XY7) && x == y)
+    {
+      append(code, "V[0xF] = 1;");
+      append(code, "V[0x%X] = 0;", x);
+      return true;
+    }
+
+    switch (decode_opcode(opcode))
+    {
+      case OP_1NNN:
+        return jump(code, nnn, exits);
+      case OP_3XNN:
+        condition = "(V[0x%X] & 0xFF) == 0x%02X";
+        break;
+      case OP_4XNN:
+        condition = "(V[0x%X] & 0xFF) != 0x%02X";
+        break;
+      case OP_5XY0:
+        if (x == y)
+          return jump(code, pc + 4, exits);
+        condition = "(V[0x%X] & 0xFF) == (V[0x%X] & 0xFF)";
+        nn = y;
+        break;
+      case OP_9XY0:
+        if (x == y)
+          return jump(code, pc + 2, exits);
+        condition = "(V[0x%X] & 0xFF) != (V[0x%X] & 0xFF)";
+        nn = y;
+        break;
+      case OP_6XNN:
+        append(code, "V[0x%X] = char(0x%02X);", x, nn);
+        return true;
+      case OP_7XNN:
+        append(code, "V[0x%X] += 0x%02X;", x, nn);
+        return true;
+      case OP_8XY0:
+        append(code, "V[0x%X] = V[0x%X] & 0xFF;", x, y);
+        return true;
+      case OP_8XY1:
+        append(code, "V[0x%X] |= (V[0x%X] & 0xFF);", x, y);
+        return true;
+      case OP_8XY2:
+        append(code, "V[0x%X] &= V[0x%X];", x, y);
+        return true;
+      case OP_8XY3:
+        append(code, "V[0x%X] ^= V[0x%X];", x, y);
+        return true;
+      case OP_8XY4:
+        append(code, "V[0xF] = ((V[0x%X] & 0xFF) + (V[0x%X] & 0xFF)) > 0xFF;", x, y);
+        append(code, "V[0x%X] += V[0x%X] & 0xFF;", x, y);
+        return true;
+      case OP_8XY5:
+        append(code, "V[0xF] = !((V[0x%X] & 0xFF) < (V[0x%X] & 0xFF));", x, y);
+        append(code, "V[0x%X] -= V[0x%X] & 0xFF;", x, y);
+        return true;
+      case OP_8XY6:
+        append(code, "V[0xF] = V[0x%X] & 1;", source);
+        append(code, "V[0x%X] = (V[0x%X] & 0xFF) >> 1;", x, source);
+        return true;
+      case OP_8XY7:
+        append(code, "V[0xF] = !(V[0x%X] < V[0x%X]);", y, x);
+        append(code, "V[0x%X] = (V[0x%X] & 0xFF) - (V[0x%X] & 0xFF);", x, y, x);
+        return true;
+      case OP_8XYE:
+        append(code, "V[0xF] = (V[0x%X] & 0xFF) >> 7;", source);
+        append(code, "V[0x%X] = (V[0x%X] & 0xFF) << 1;", x, source);
+        return true;
+      case OP_ANNN:
+        append(code, "*I = 0x%03X;", nnn);
+        return true;
+      case OP_FX1E:
+        append(code, "*I += V[0x%X];", x);
+        if (flags.add_i_overflow)
+          append(code, "V[0xF] = *I > 0xFFF;");
+        return true;
+      default:
+        return false;
+    }
+
+    // Skips end the block on either path
+    char test[64];
+    snprintf(test, sizeof(test), condition, x, nn);
+    append(code, "*program_counter = %s ? 0x%03X : 0x%03X;", test, pc + 4, pc + 2);
+    exits.push_back(pc + 2);
+    exits.push_back(pc + 4);
+    return true;
+  }
+
+  /**
+   *  Adds where execution continues after the interpreter runs an opcode
+   *  that isn't translated. Computed jumps and returns can't be followed.
+   */
+  void interpreted_exits(unsigned short opcode, unsigned int pc, std::vector<unsigned int>& exits)
+  {
+    switch (decode_opcode(opcode))
+    {
+      case OP_0NNN:
+      case OP_00EE:
+      case OP_BNNN:
+        return;
+      case OP_2NNN:
+        exits.push_back(opcode & 0x0FFF);
+        break;
+      case OP_EX9E:
+      case OP_EXA1:
+        exits.push_back(pc + 4);
+        break;
+      default:
+        break;
+    }
+
+    exits.push_back(pc + 2);
+  }
+
+  /**
+   *  Follows control flow from 0x200 and translates a block at every
+   *  address reached by a jump, a skip or an interpreted opcode.
+   */
+  std::map<unsigned int, Block> find_blocks(const unsigned char* image, int length, const Flags& flags)
+  {
+    std::map<unsigned int, Block> blocks;
+    std::vector<bool> visited(0x1000, false);
+    std::vector<unsigned int> pending(1, 0x200);
+    unsigned int limit = 0x200 + length;
+
+    while (!pending.empty())
+    {
+      unsigned int start = pending.back();
+      pending.pop_back();
+
+      if (start < 0x200 || start + 1 >= limit || visited[start])
+        continue;
+      visited[start] = true;
+
+      Block block = {start, start, 0, ""};
+      std::vector<unsigned int> exits;
+      unsigned int pc = start;
+
+      while (exits.empty() && pc + 1 < limit && block.length < Recompiled::MAX_BLOCK_LENGTH)
+      {
+        unsigned short opcode = (image[pc - 0x200] << 8) | image[pc + 1 - 0x200];
+
+        if (!translate(opcode, pc, flags, block.code, exits))
+        {
+          if (block.length == 0)
+            interpreted_exits(opcode, pc, exits);
+          break;
+        }
+
+        block.length++;
+        pc += 2;
+      }
+
+      if (block.length > 0)
+      {
+        if (exits.empty())
+        {
+          // Continue with the opcode after the block, interpreted if it
+          // isn't translated
+          append(block.code, "*program_counter = 0x%03X;", pc);
+          exits.push_back(pc);
+        }
+
+        block.end = pc;
+        blocks[start] = block;
+      }
+
+      pending.insert(pending.end(), exits.begin(), exits.end());
+    }
+
+    return blocks;
+  }
+
+  bool read_rom(const char* file, std::vector<unsigned char>& image)
+  {
+    FILE* input = fopen(file, "rb");
+    if (!input)
+      return false;
+
+    image.resize(0xE00);
+    image.resize(fread(&image[0], 1, image.size(), input));
+    fclose(input);
+
+    return true;
+  }
+
+  void write_program(FILE* output, int number, const char* file, const std::vector<unsigned char>& image,
+                     const std::map<unsigned int, Block>& blocks, QUIRK_PROFILES quirks)
+  {
+    fprintf(output, "  // %s\n", file);
+    fprintf(output, "  const unsigned char image_%d[] =\n  {", number);
+    for (size_t i = 0; i < image.size(); i++)
+      fprintf(output, "%s0x%02X%s", i % 16 ? " " : "\n    ", image[i], i + 1 < image.size() ? "," : "");
+    fprintf(output, "\n  };\n\n");
+
+    std::map<unsigned int, Block>::const_iterator block;
+
+    for (block = blocks.begin(); block != blocks.end(); ++block)
+    {
+      fprintf(output, "  void block_%d_%03X(char* V, short* I, unsigned int* program_counter)\n  {\n", number, block->first);
+      fprintf(output, "%s  }\n\n", block->second.code.c_str());
+    }
+
+    fprintf(output, "  const JIT::Block blocks_%d[] =\n  {\n", number);
+    for (block = blocks.begin(); block != blocks.end(); ++block)
+    {
+      const Block& translated = block->second;
+      fprintf(output, "    {block_%d_%03X, 0x%03X, 0x%03X, %d},\n", number, translated.start, translated.start,
+              translated.end, translated.length);
+    }
+    fprintf(output, "  };\n\n");
+
+    fprintf(output, "  const RecompiledProgram program_%d = {image_%d, %d, %s, blocks_%d, %d};\n",
+            number, number, (int)image.size(), quirk_enums[quirks], number, (int)blocks.size());
+    fprintf(output, "  const bool registered_%d = Recompiled::add(&program_%d);\n", number, number);
+  }
+}
+
+void show_help();
+
+int main(int argc, char **argv)
+{
+  QUIRK_PROFILES quirks = QUIRKS_DEFAULT;
+  const char* output_file = 0;
+  std::vector<const char*> roms;
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* value = i + 1 < argc ? argv[i + 1] : 0;
+    bool valid = true;
+
+    if (argv[i][0] != '-')
+    {
+      roms.push_back(argv[i]);
+      continue;
+    }
+
+    if (!value)
+      valid = false;
+    else if (!std::strcmp(argv[i], "-o"))
+      output_file = value;
+    else if (!std::strcmp(argv[i], "-q"))
+    {
+      valid = false;
+      for (int profile = 0; profile < QUIRK_PROFILE_COUNT; profile++)
+      {
+        if (!std::strcmp(value, quirk_names[profile]))
+        {
+          quirks = QUIRK_PROFILES(profile);
+          valid = true;
+        }
+      }
+    }
+    else
+      valid = false;
+
+    if (!valid)
+    {
+      show_help();
+      return 1;
+    }
+
+    i++;
+  }
+
+  if (!output_file || roms.empty())
+  {
+    show_help();
+    return 1;
+  }
+
+  const Flags profiles[QUIRK_PROFILE_COUNT] =
+  {
+    flags_of<DefaultQuirks>(), flags_of<Chip8Quirks>(), flags_of<SuperChipQuirks>(), flags_of<ModernQuirks>()
+  };
+
+  FILE* output = fopen(output_file, "w");
+  if (!output)
+  {
+    fprintf(stderr, "Couldn't write %s\n", output_file);
+    return 1;
+  }
+
+  fprintf(output, "// Generated by yace-recompile, do not edit.\n\n");
+  fprintf(output, "#include \"include/Recompiled.h\"\n\n");
+  fprintf(output, "using namespace YACE;\n\nnamespace\n{\n");
+
+  int failed = 0;
+  int written = 0;
+
+  for (size_t rom = 0; rom < roms.size(); rom++)
+  {
+    std::vector<unsigned char> image;
+
+    if (!read_rom(roms[rom], image))
+    {
+      fprintf(stderr, "Couldn't open %s\n", roms[rom]);
+      failed++;
+      continue;
+    }
+
+    std::map<unsigned int, Block> blocks = find_blocks(image.empty() ? 0 : &image[0], image.size(), profiles[quirks]);
+
+    if (blocks.empty())
+    {
+      fprintf(stderr, "%s\tno blocks\n", roms[rom]);
+      continue;
+    }
+
+    if (written++)
+      fprintf(output, "\n");
+    write_program(output, rom, roms[rom], image, blocks, quirks);
+
+    int opcodes = 0;
+    for (std::map<unsigned int, Block>::iterator block = blocks.begin(); block != blocks.end(); ++block)
+      opcodes += block->second.length;
+
+    fprintf(stderr, "%s\t%d blocks\t%d opcodes\n", roms[rom], (int)blocks.size(), opcodes);
+  }
+
+  fprintf(output, "}\n");
+  fclose(output);
+
+  return failed ? 1 : 0;
+}
+
+void show_help()
+{
+  printf("Usage:\n");
+  printf("\tyace-recompile [options] -o <output.cpp> <rom>...\n\n");
+  printf("\t-o <file>\tC++ file to write, compiled from the top of the tree\n");
+  printf("\t-q <quirks>\tdefault, chip8, superchip or modern (default)\n");
+}
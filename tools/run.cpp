@@ -0,0 +1,397 @@
+/**
+ * Runs ROMs headless on a pool of threads and prints timings and
+ * framebuffer hashes. A single ROM can be run recording a movie of its
+ * input or playing one back.
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include "../include/Chip8.h"
+#include "../include/Movie.h"
+
+using namespace YACE;
+
+namespace
+{
+  /**
+   *  Key change applied before the given frame is stepped.
+   */
+  struct InputEvent
+  {
+    int frame;
+    Chip8::EMU_KEYS key;
+    bool pressed;
+  };
+
+  struct Result
+  {
+    std::string error;
+    double seconds;
+    int cycles;                               // CPU cycles per frame
+    std::vector<unsigned long long> hashes;   // One per hash frame
+  };
+
+  struct Options
+  {
+    int frames;
+    int cycles;
+    CPU::ENGINES engine;
+    QUIRK_PROFILES quirks;
+    std::vector<int> hash_frames;             // Sorted
+    std::vector<InputEvent> input;            // Sorted by frame
+    const char* record;                       // Movie to write, or 0
+    const char* movie;                        // Movie to play back, or 0
+#ifdef _PROFILE_
+    Profile* profile;                         // Shared by every ROM, or 0
+#endif
+  };
+
+  void run_rom(const char* file, const Options& options, Result& result)
+  {
+    Chip8* chip8 = new Chip8();
+    size_t event = 0;
+    size_t hash = 0;
+
+    result.seconds = 0;
+    result.cycles = options.cycles;
+
+    try
+    {
+      chip8->set_cpu_engine(options.engine);
+      chip8->set_quirks(options.quirks);
+      chip8->set_cpu_cycles(options.cycles);
+#ifdef _PROFILE_
+      chip8->set_profile(options.profile);
+#endif
+      chip8->load_game(file);
+
+      // Checkpoints are taken at the hash frames
+      Movie movie;
+
+      if (options.movie)
+      {
+        movie.load(options.movie);
+        if (movie.get_rom_hash() != chip8->get_rom_hash())
+          throw "Movie was recorded with another game!";
+
+        movie.play(*chip8);
+        result.cycles = chip8->get_cpu_cycles();
+      }
+      else if (options.record)
+        movie.record(*chip8);
+
+      std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+      for (int frame = 1; frame <= options.frames; frame++)
+      {
+        for (; event < options.input.size() && options.input[event].frame <= frame; event++)
+          chip8->set_key(options.input[event].key, options.input[event].pressed);
+
+        chip8->step();
+
+        for (; hash < options.hash_frames.size() && options.hash_frames[hash] == frame; hash++)
+        {
+          result.hashes.push_back(chip8->frame_hash());
+
+          if (options.record)
+            movie.checkpoint();
+        }
+      }
+
+      result.seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+      if (options.record)
+        movie.save(options.record);
+
+      if (movie.get_mismatches())
+      {
+        char error[64];
+        snprintf(error, sizeof(error), "Movie diverged at cycle %llu", movie.get_first_mismatch());
+        result.error = error;
+      }
+    }
+    catch (const char* error)
+    {
+      result.error = error;
+    }
+
+    delete chip8;
+  }
+
+  /**
+   *  Reads "<frame> <key 0-F> <1|0>" lines. Lines starting with # are
+   *  ignored.
+   */
+  bool read_input(const char* file, std::vector<InputEvent>& input)
+  {
+    FILE* script = fopen(file, "r");
+    if (!script)
+      return false;
+
+    char line[256];
+    bool valid = true;
+
+    while (valid && fgets(line, sizeof(line), script))
+    {
+      int frame;
+      unsigned int key;
+      int pressed;
+
+      if (line[0] == '#' || line[strspn(line, " \t\r\n")] == '\0')
+        continue;
+
+      if (sscanf(line, "%d %x %d", &frame, &key, &pressed) != 3 || key > 0xF)
+      {
+        valid = false;
+        break;
+      }
+
+      InputEvent event = {frame, Chip8::EMU_KEYS(Chip8::KEY_0 + key), pressed != 0};
+      input.push_back(event);
+    }
+
+    fclose(script);
+
+    std::stable_sort(input.begin(), input.end(),
+                     [](const InputEvent& a, const InputEvent& b) {return a.frame < b.frame;});
+    return valid;
+  }
+
+  /**
+   *  Appends the non-empty lines of a ROM list file.
+   */
+  bool read_list(const char* file, std::vector<std::string>& roms)
+  {
+    FILE* list = fopen(file, "r");
+    if (!list)
+      return false;
+
+    char line[4096];
+
+    while (fgets(line, sizeof(line), list))
+    {
+      line[strcspn(line, "\r\n")] = '\0';
+      if (line[0] && line[0] != '#')
+        roms.push_back(line);
+    }
+
+    fclose(list);
+    return true;
+  }
+
+  bool read_frames(const char* text, std::vector<int>& frames)
+  {
+    for (const char* position = text; *position; )
+    {
+      char* end;
+      long frame = strtol(position, &end, 10);
+
+      if (end == position || frame <= 0)
+        return false;
+
+      frames.push_back(frame);
+      position = *end == ',' ? end + 1 : end;
+    }
+
+    std::sort(frames.begin(), frames.end());
+    frames.erase(std::unique(frames.begin(), frames.end()), frames.end());
+    return !frames.empty();
+  }
+}
+
+void show_help();
+
+int main(int argc, char **argv)
+{
+  Options options;
+  options.frames = 600;
+  options.cycles = 400;
+  options.engine = CPU::THREADED;
+  options.quirks = QUIRKS_DEFAULT;
+  options.record = 0;
+  options.movie = 0;
+
+  int threads = std::thread::hardware_concurrency();
+  std::vector<std::string> roms;
+#ifdef _PROFILE_
+  const char* profile_file = 0;
+  options.profile = 0;
+#endif
+
+  for (int i = 1; i < argc; i++)
+  {
+    const char* value = i + 1 < argc ? argv[i + 1] : 0;
+    bool valid = true;
+
+    if (argv[i][0] != '-')
+    {
+      roms.push_back(argv[i]);
+      continue;
+    }
+
+    if (!value)
+      valid = false;
+    else if (!std::strcmp(argv[i], "-c"))
+      valid = (options.cycles = atoi(value)) > 0;
+    else if (!std::strcmp(argv[i], "-e"))
+    {
+      if (!std::strcmp(value, "interpreter"))
+        options.engine = CPU::INTERPRETER;
+      else if (!std::strcmp(value, "threaded"))
+        options.engine = CPU::THREADED;
+      else if (!std::strcmp(value, "dynarec"))
+        options.engine = CPU::DYNAREC;
+      else if (!std::strcmp(value, "recompiled"))
+        options.engine = CPU::RECOMPILED;
+      else
+        valid = false;
+    }
+    else if (!std::strcmp(argv[i], "-f"))
+      valid = (options.frames = atoi(value)) > 0;
+    else if (!std::strcmp(argv[i], "-h"))
+      valid = read_frames(value, options.hash_frames);
+    else if (!std::strcmp(argv[i], "-i"))
+      valid = read_input(value, options.input);
+    else if (!std::strcmp(argv[i], "-l"))
+      valid = read_list(value, roms);
+    else if (!std::strcmp(argv[i], "-m"))
+      options.movie = value;
+#ifdef _PROFILE_
+    else if (!std::strcmp(argv[i], "-p"))
+      profile_file = value;
+#endif
+    else if (!std::strcmp(argv[i], "-q"))
+    {
+      if (!std::strcmp(value, "default"))
+        options.quirks = QUIRKS_DEFAULT;
+      else if (!std::strcmp(value, "chip8"))
+        options.quirks = QUIRKS_CHIP8;
+      else if (!std::strcmp(value, "superchip"))
+        options.quirks = QUIRKS_SUPERCHIP;
+      else if (!std::strcmp(value, "modern"))
+        options.quirks = QUIRKS_MODERN;
+      else
+        valid = false;
+    }
+    else if (!std::strcmp(argv[i], "-r"))
+      options.record = value;
+    else if (!std::strcmp(argv[i], "-t"))
+      valid = (threads = atoi(value)) > 0;
+    else
+      valid = false;
+
+    if (!valid)
+    {
+      show_help();
+      return 1;
+    }
+
+    i++;
+  }
+
+  if (roms.empty() || ((options.record || options.movie) && roms.size() != 1))
+  {
+    show_help();
+    return 1;
+  }
+
+  if (options.hash_frames.empty())
+    options.hash_frames.push_back(options.frames);
+
+#ifdef _PROFILE_
+  // One profile for the whole corpus, so the ROMs run one at a time
+  Profile profile;
+
+  if (profile_file)
+  {
+    options.profile = &profile;
+    threads = 1;
+  }
+#endif
+
+  // Each thread takes the next ROM until none are left
+  std::vector<Result> results(roms.size());
+  std::vector<std::thread> pool;
+  std::atomic<size_t> next(0);
+
+  if (threads < 1)
+    threads = 1;
+
+  for (int t = 0; t < threads && t < (int)roms.size(); t++)
+  {
+    pool.push_back(std::thread([&]()
+    {
+      for (size_t rom = next++; rom < roms.size(); rom = next++)
+        run_rom(roms[rom].c_str(), options, results[rom]);
+    }));
+  }
+
+  for (size_t t = 0; t < pool.size(); t++)
+    pool[t].join();
+
+  // rom, seconds, MIPS, then frame:hash for every hash frame
+  int failed = 0;
+
+  for (size_t rom = 0; rom < roms.size(); rom++)
+  {
+    const Result& result = results[rom];
+
+    if (!result.error.empty())
+    {
+      printf("%s\terror\t%s\n", roms[rom].c_str(), result.error.c_str());
+      failed++;
+      continue;
+    }
+
+    printf("%s\t%.6f\t%.3f", roms[rom].c_str(), result.seconds,
+           (double)options.frames * result.cycles / result.seconds / 1e6);
+
+    for (size_t hash = 0; hash < result.hashes.size(); hash++)
+      printf("\t%d:%.16llx", options.hash_frames[hash], result.hashes[hash]);
+
+    printf("\n");
+  }
+
+#ifdef _PROFILE_
+  if (profile_file)
+  {
+    FILE* report = fopen(profile_file, "w");
+    if (!report)
+    {
+      fprintf(stderr, "Couldn't write %s\n", profile_file);
+      return 1;
+    }
+
+    profile.write_flat(report);
+    fclose(report);
+  }
+#endif
+
+  return failed ? 1 : 0;
+}
+
+void show_help()
+{
+  printf("Usage:\n");
+  printf("\tyace-run [options] <rom>...\n\n");
+  printf("\t-c <cycles>\tCPU cycles per frame (400)\n");
+  printf("\t-e <engine>\tinterpreter, threaded, dynarec or recompiled (threaded)\n");
+  printf("\t-f <frames>\tFrames to run (600)\n");
+  printf("\t-h <frames>\tComma separated frames to hash (the last frame)\n");
+  printf("\t-i <file>\tInput script of \"<frame> <key 0-F> <1|0>\" lines\n");
+  printf("\t-l <file>\tFile listing one ROM per line\n");
+  printf("\t-m <file>\tPlay back a movie of the ROM, checking its checkpoints\n");
+#ifdef _PROFILE_
+  printf("\t-p <file>\tWrite the profile of all ROMs, run on one thread\n");
+#endif
+  printf("\t-q <quirks>\tdefault, chip8, superchip or modern (default)\n");
+  printf("\t-r <file>\tRecord a movie of the ROM, with checkpoints at the hash frames\n");
+  printf("\t-t <threads>\tWorker threads (one per core)\n");
+}
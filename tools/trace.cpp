@@ -0,0 +1,92 @@
+/**
+ * Prints a trace written by Trace::save as disassembly.
+ */
+
+#include <cstdio>
+#include <cstring>
+#include "../include/Opcodes.h"
+#include "../include/Trace.h"
+
+void show_help();
+bool print_trace(FILE* input);
+
+int main(int argc, char **argv)
+{
+  if (argc != 2)
+  {
+    show_help();
+    return 1;
+  }
+
+  FILE* input = std::strcmp(argv[1], "-") ? fopen(argv[1], "rb") : stdin;
+
+  if (!input)
+  {
+    fprintf(stderr, "Couldn't open %s\n", argv[1]);
+    return 1;
+  }
+
+  bool valid = print_trace(input);
+
+  if (input != stdin)
+    fclose(input);
+
+  if (!valid)
+  {
+    fprintf(stderr, "%s is not a valid trace\n", argv[1]);
+    return 1;
+  }
+
+  return 0;
+}
+
+/**
+ *  Prints one line per record:
+ *  cycle, address, opcode, mnemonic, I and the changed registers.
+ */
+bool print_trace(FILE* input)
+{
+  using namespace YACE;
+
+  TraceHeader header;
+
+  if (fread(&header, sizeof(header), 1, input) != 1 ||
+      header.magic != TraceHeader::MAGIC || header.version != TraceHeader::VERSION ||
+      header.record_size != sizeof(TraceRecord))
+    return false;
+
+  TraceRecord record;
+  char mnemonic[32];
+
+  for (unsigned int i = 0; i < header.count; i++)
+  {
+    if (fread(&record, sizeof(record), 1, input) != 1)
+      return false;
+
+    int x = (record.opcode & 0x0F00) >> 8;
+
+    printf("%10u  %.3X  %.4X  %-18s I=%.3X", record.cycle, record.program_counter,
+           record.opcode, disassemble(record.opcode, mnemonic, sizeof(mnemonic)), record.I);
+
+    for (int r = 0; r < 16; r++)
+    {
+      if (!(record.changed & (1 << r)))
+        continue;
+
+      if (r == x)
+        printf("  V%X=%.2X", r, record.value);
+      else
+        printf("  V%X*", r);
+    }
+
+    printf("\n");
+  }
+
+  return true;
+}
+
+void show_help()
+{
+  printf("Usage:\n");
+  printf("\tyace-trace <trace file | ->\n");
+}